@@ -99,6 +99,16 @@ namespace psudb {
             return m_bits;
         }
 
+        // raw access to the underlying bytes, for persisting the array.
+        // at least (size() + 7) / 8 bytes are valid.
+        [[nodiscard]] inline std::byte* data() {
+            return m_data;
+        }
+
+        [[nodiscard]] inline const std::byte* data() const {
+            return m_data;
+        }
+
         void swap(BitArray& other) noexcept {
             std::swap(other.m_bits, m_bits);
             std::swap(other.m_memory_usage, m_memory_usage);
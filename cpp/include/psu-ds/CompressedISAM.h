@@ -0,0 +1,377 @@
+/*
+ * psu-ds/CompressedISAM.h
+ *
+ * Copyright (C) 2023-2024 Douglas B. Rumbaugh <drumbaugh@psu.edu)
+ * Distributed under the Modified BSD License.
+ *
+ * A variant of the static ISAM tree that stores its keys compressed. The
+ * sorted records are split into leaf blocks of FANOUT records, and the keys
+ * of each block are stored using frame-of-reference encoding: the block's
+ * smallest key is kept as its base, and each key is stored as its offset
+ * from the base, truncated to the smallest of 1, 2, 4 or 8 bytes that fits
+ * the block's largest offset. Values are stored separately and are not
+ * compressed.
+ *
+ * The block bases are indexed by an ISAMTree, so its internal nodes hold the
+ * minimum key of each block, and lower_bound remains exact. The offsets
+ * within a block can be binary searched without decoding them, and range
+ * scans decode a block at a time, using AVX2 when the CPU supports it.
+ *
+ * On dense integer keys, most offsets fit in one or two bytes, and so keys
+ * take a quarter or less of their uncompressed space. Keys must be
+ * integers.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "psu-util/alignment.h"
+#include "psu-ds/StaticISAM.h"
+
+namespace psudb {
+
+#if defined(__x86_64__)
+/*
+ * Decode the n frame-of-reference encoded keys in deltas into out, by
+ * adding base to each, using AVX2 to widen and add a vector of offsets at a
+ * time. Must only be called if the CPU supports AVX2.
+ */
+template <typename K, typename T>
+__attribute__((target("avx2")))
+inline void for_decode_avx2(const T *deltas, size_t n, K base, K *out)
+{
+    size_t i = 0;
+
+    if constexpr (sizeof(K) == 8 && sizeof(T) <= 8) {
+        __m256i b = _mm256_set1_epi64x((int64_t) base);
+        for (; i + 4 <= n; i += 4) {
+            __m256i v;
+            if constexpr (sizeof(T) == 1) {
+                int32_t packed;
+                memcpy(&packed, deltas + i, sizeof(packed));
+                v = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed));
+            } else if constexpr (sizeof(T) == 2) {
+                v = _mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i *) (deltas + i)));
+            } else if constexpr (sizeof(T) == 4) {
+                v = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *) (deltas + i)));
+            } else {
+                v = _mm256_loadu_si256((const __m256i *) (deltas + i));
+            }
+
+            _mm256_storeu_si256((__m256i *) (out + i), _mm256_add_epi64(v, b));
+        }
+    } else if constexpr (sizeof(K) == 4 && sizeof(T) <= 4) {
+        __m256i b = _mm256_set1_epi32((int32_t) base);
+        for (; i + 8 <= n; i += 8) {
+            __m256i v;
+            if constexpr (sizeof(T) == 1) {
+                v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (deltas + i)));
+            } else if constexpr (sizeof(T) == 2) {
+                v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (deltas + i)));
+            } else {
+                v = _mm256_loadu_si256((const __m256i *) (deltas + i));
+            }
+
+            _mm256_storeu_si256((__m256i *) (out + i), _mm256_add_epi32(v, b));
+        }
+    }
+
+    typedef std::make_unsigned_t<K> U;
+    for (; i < n; i++) {
+        out[i] = (K) (U) ((U) base + (U) deltas[i]);
+    }
+}
+#endif
+
+template <typename K, typename V, size_t FANOUT=128>
+class CompressedISAMTree {
+private:
+    typedef std::pair<K, V> R;
+    typedef std::make_unsigned_t<K> U;
+
+    static_assert(std::is_integral_v<K>, "CompressedISAMTree requires integer keys");
+    static_assert(FANOUT > 0, "Fanout must be positive");
+
+    /*
+     * The index over the blocks. Each of its records maps the base key of a
+     * block to the offset of the block's encoded keys within m_packed.
+     */
+    typedef ISAMTree<K, size_t, 16, ISAMLayout::EYTZINGER> index_t;
+
+public:
+    struct RangeQueryParameters {
+        K lower_bound;
+        K upper_bound;
+    };
+
+public:
+    static CompressedISAMTree *build(std::vector<R> &records) {
+        std::sort(records.begin(), records.end());
+        return new CompressedISAMTree(records);
+    }
+
+    static CompressedISAMTree *build_presorted(std::vector<R> &records) {
+        return new CompressedISAMTree(records);
+    }
+
+    /*
+     * Build from several runs of records, each of which is already sorted,
+     * by merging them with kway_merge. The runs are left empty.
+     */
+    static CompressedISAMTree *build_from_runs(std::vector<std::vector<R>> &runs) {
+        auto records = kway_merge(runs);
+        return new CompressedISAMTree(records);
+    }
+
+    std::vector<R> unbuild() {
+        std::vector<R> records;
+        records.reserve(m_values.size());
+
+        K keys[FANOUT];
+        for (size_t j=0; j<block_count(); j++) {
+            decode_block(j, keys);
+            for (size_t i=0; i<block_len(j); i++) {
+                records.push_back({keys[i], std::move(m_values[j * FANOUT + i])});
+            }
+        }
+
+        std::vector<V>().swap(m_values);
+        std::vector<byte>().swap(m_packed);
+        std::vector<uint8_t>().swap(m_widths);
+        std::vector<std::pair<K, size_t>> empty;
+        m_index.reset(index_t::build_presorted(empty));
+
+        return records;
+    }
+
+    std::vector<R> query(void *q) {
+        std::vector<R> rs;
+
+        /* return an empty result set if q is invalid */
+        if (q == nullptr) {
+            return rs;
+        }
+
+        auto parms = (CompressedISAMTree::RangeQueryParameters*) q;
+
+        size_t idx = lower_bound(parms->lower_bound);
+
+        K keys[FANOUT];
+        for (size_t j=idx / FANOUT; j<block_count(); j++) {
+            decode_block(j, keys);
+
+            for (size_t i=(j == idx / FANOUT) ? idx % FANOUT : 0; i<block_len(j); i++) {
+                if (keys[i] >= parms->upper_bound) {
+                    return rs;
+                }
+
+                rs.push_back({keys[i], m_values[j * FANOUT + i]});
+            }
+        }
+
+        return rs;
+    }
+
+    std::vector<R> query_merge(std::vector<R> &rsa, std::vector<R> &rsb) {
+        rsa.insert(rsa.end(), rsb.begin(), rsb.end());
+        return std::move(rsa);
+    }
+
+    /*
+     * Returns the index of the first record with a key greater than or
+     * equal to key, or record_count() if there is no such record.
+     */
+    size_t lower_bound(K key) {
+        /*
+         * The lower bound falls within the last block whose base is less
+         * than key, or at the start of the block after it. Every earlier
+         * block only contains keys no larger than that base.
+         */
+        size_t j = m_index->lower_bound(key);
+        if (j == 0) {
+            return 0;
+        }
+
+        j--;
+        U delta = (U) key - (U) block_base(j);
+        const byte *packed = m_packed.data() + block_offset(j);
+        size_t len = block_len(j);
+
+        return j * FANOUT + with_width(m_widths[j], [&](auto width) -> size_t {
+            typedef decltype(width) T;
+            if (delta > std::numeric_limits<T>::max()) {
+                return len;
+            }
+
+            const T *deltas = (const T *) packed;
+            return std::lower_bound(deltas, deltas + len, (T) delta) - deltas;
+        });
+    }
+
+    /*
+     * Decode the record at position idx, in key order, into rec. Returns 1
+     * on success, and 0 if idx is out of range.
+     */
+    int get_record(size_t idx, R *rec) {
+        if (idx >= m_values.size()) {
+            return 0;
+        }
+
+        size_t j = idx / FANOUT;
+        const byte *packed = m_packed.data() + block_offset(j);
+        U delta = with_width(m_widths[j], [&](auto width) -> U {
+            return ((const decltype(width) *) packed)[idx % FANOUT];
+        });
+
+        *rec = {(K) (U) ((U) block_base(j) + delta), m_values[idx]};
+        return 1;
+    }
+
+    size_t record_count() {
+        return m_values.size();
+    }
+
+    size_t block_count() {
+        return m_widths.size();
+    }
+
+    /*
+     * Returns the number of bytes used by the encoded keys and the values.
+     */
+    size_t data_memory_usage() {
+        return m_packed.size() + m_widths.size() + m_values.size() * sizeof(V);
+    }
+
+    /*
+     * Returns the number of bytes used by the index over the blocks,
+     * including the block bases.
+     */
+    size_t index_memory_usage() {
+        return m_index->record_count() * sizeof(std::pair<K, size_t>) + m_index->index_memory_usage();
+    }
+
+private:
+    std::vector<V> m_values;
+
+    /*
+     * The encoded keys of every block, stored contiguously, and the width
+     * of each block's offsets in bytes. Each block starts at a multiple of
+     * its width, so that its offsets are aligned.
+     */
+    std::vector<byte> m_packed;
+    std::vector<uint8_t> m_widths;
+
+    std::unique_ptr<index_t> m_index;
+
+    CompressedISAMTree(std::vector<R> &records) {
+        std::vector<std::pair<K, size_t>> blocks;
+        m_values.reserve(records.size());
+
+        for (size_t start=0; start<records.size(); start+=FANOUT) {
+            size_t len = std::min(FANOUT, records.size() - start);
+            K base = records[start].first;
+            U max_delta = (U) records[start + len - 1].first - (U) base;
+
+            uint8_t width = sizeof(U);
+            for (uint8_t w : {1, 2, 4}) {
+                if (w < sizeof(U) && max_delta < ((U) 1 << (8 * w))) {
+                    width = w;
+                    break;
+                }
+            }
+
+            size_t offset = (m_packed.size() + width - 1) / width * width;
+            m_packed.resize(offset + len * width);
+
+            with_width(width, [&](auto w) {
+                typedef decltype(w) T;
+                T *deltas = (T *) (m_packed.data() + offset);
+                for (size_t i=0; i<len; i++) {
+                    deltas[i] = (T) ((U) records[start + i].first - (U) base);
+                }
+            });
+
+            blocks.push_back({base, offset});
+            m_widths.push_back(width);
+        }
+
+        for (auto &rec : records) {
+            m_values.push_back(std::move(rec.second));
+        }
+        m_packed.shrink_to_fit();
+
+        std::vector<R>().swap(records);
+        m_index.reset(index_t::build_presorted(blocks));
+    }
+
+    /*
+     * Call f with a value of the unsigned integer type that is width bytes
+     * wide, and return its result.
+     */
+    template <typename F>
+    static auto with_width(uint8_t width, F &&f) {
+        switch (width) {
+        case 1:
+            return f((uint8_t) 0);
+        case 2:
+            return f((uint16_t) 0);
+        case 4:
+            return f((uint32_t) 0);
+        default:
+            return f((uint64_t) 0);
+        }
+    }
+
+    K block_base(size_t j) {
+        return m_index->get_record_at(j)->first;
+    }
+
+    size_t block_offset(size_t j) {
+        return m_index->get_record_at(j)->second;
+    }
+
+    size_t block_len(size_t j) {
+        return std::min(FANOUT, m_values.size() - j * FANOUT);
+    }
+
+    /*
+     * Decode the keys of block j into keys, which must have room for
+     * FANOUT keys.
+     */
+    void decode_block(size_t j, K *keys) {
+        K base = block_base(j);
+        const byte *packed = m_packed.data() + block_offset(j);
+        size_t len = block_len(j);
+
+        with_width(m_widths[j], [&](auto width) {
+            typedef decltype(width) T;
+            const T *deltas = (const T *) packed;
+
+#if defined(__x86_64__)
+            if constexpr ((sizeof(K) == 4 || sizeof(K) == 8) && sizeof(T) <= sizeof(K)) {
+                static const bool avx2 = __builtin_cpu_supports("avx2");
+                if (avx2) {
+                    for_decode_avx2(deltas, len, base, keys);
+                    return;
+                }
+            }
+#endif
+
+            for (size_t i=0; i<len; i++) {
+                keys[i] = (K) (U) ((U) base + (U) deltas[i]);
+            }
+        });
+    }
+};
+
+}
@@ -0,0 +1,337 @@
+/*
+ * psu-ds/PGMIndex.h
+ *
+ * Copyright (C) 2023-2024 Douglas B. Rumbaugh <drumbaugh@psu.edu)
+ * Distributed under the Modified BSD License.
+ *
+ * A simple map implementation based on a static, in-memory learned index,
+ * in the style of the PGM-index [1]. It exposes the same interface as
+ * ISAMTree, and so can be used in its place (for example, as the level
+ * structure of a BentleySaxe).
+ *
+ * The sorted records are covered by a sequence of linear segments, each of
+ * which predicts the position of a key to within EPSILON records. The
+ * segments are found with a greedy "shrinking cone" fit, which starts a new
+ * segment whenever no single slope can keep every key seen so far within
+ * the error bound. The first keys of the segments are then indexed in the
+ * same way, using an error bound of EPSILON_RECURSIVE, and so on until a
+ * single segment remains. A lookup walks down these levels, at each one
+ * searching only a small window around the predicted position.
+ *
+ * On keys that are close to uniformly distributed, very few segments are
+ * needed, and so the index is far smaller than the internal levels of an
+ * ISAMTree. Keys must be arithmetic.
+ *
+ * [1] P. Ferragina and G. Vinciguerra. The PGM-index: a fully-dynamic
+ *     compressed learned index with provable worst-case bounds. PVLDB
+ *     13(8):1162-1175, 2020.
+ */
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "psu-ds/PriorityQueue.h"
+
+namespace psudb {
+
+template <typename K, typename V, size_t EPSILON=64, size_t EPSILON_RECURSIVE=4>
+class PGMIndex {
+private:
+    typedef std::pair<K, V> R;
+
+    static_assert(std::is_arithmetic_v<K>, "PGMIndex requires arithmetic keys");
+    static_assert(EPSILON > 0 && EPSILON_RECURSIVE > 0, "Error bounds must be positive");
+
+    /*
+     * A segment predicts the position of key k >= key as
+     * pos + slope * (k - key). Each level of segments ends with a sentinel,
+     * whose pos is the number of entries covered by the level, so that the
+     * entries covered by segment i are always [seg[i].pos, seg[i+1].pos).
+     */
+    struct segment {
+        K key;
+        double slope;
+        size_t pos;
+    };
+
+public:
+    struct RangeQueryParameters {
+        K lower_bound;
+        K upper_bound;
+    };
+
+public:
+    static PGMIndex *build(std::vector<R> &records) {
+        std::sort(records.begin(), records.end());
+        return new PGMIndex(records);
+    }
+
+    static PGMIndex *build_presorted(std::vector<R> &records) {
+        return new PGMIndex(records);
+    }
+
+    /*
+     * Build from several runs of records, each of which is already sorted,
+     * by merging them with kway_merge. The runs are left empty.
+     */
+    static PGMIndex *build_from_runs(std::vector<std::vector<R>> &runs) {
+        auto records = kway_merge(runs);
+        return new PGMIndex(records);
+    }
+
+    std::vector<R> unbuild() {
+        return std::move(m_data);
+    }
+
+    std::vector<R> query(void *q) {
+        std::vector<R> rs;
+
+        /* return an empty result set if q is invalid */
+        if (q == nullptr) {
+            return rs;
+        }
+
+        auto parms = (PGMIndex::RangeQueryParameters*) q;
+
+        size_t idx = lower_bound(parms->lower_bound);
+
+        while (idx < m_data.size() && m_data[idx].first < parms->upper_bound) {
+            rs.emplace_back(m_data[idx++]);
+        }
+
+        return rs;
+    }
+
+    std::vector<R> query_merge(std::vector<R> &rsa, std::vector<R> &rsb) {
+        rsa.insert(rsa.end(), rsb.begin(), rsb.end());
+        return std::move(rsa);
+    }
+
+    /*
+     * Returns the index of the first record with a key greater than or
+     * equal to key, or record_count() if there is no such record.
+     */
+    size_t lower_bound(K key) {
+        if (m_data.size() == 0 || key <= m_data[0].first) {
+            return 0;
+        }
+
+        /*
+         * Find the segment covering key on each level, from the single
+         * segment on the top level down. Each is the last segment on its
+         * level whose first key is no larger than key.
+         */
+        size_t idx = 0;
+        for (size_t l=m_level_offsets.size() - 1; l > 0; l--) {
+            const segment *seg = m_segments.data() + m_level_offsets[l] + idx;
+            const segment *below = m_segments.data() + m_level_offsets[l - 1];
+
+            idx = search<true>([below](size_t i) { return below[i].key; }, key, seg, EPSILON_RECURSIVE) - 1;
+        }
+
+        const segment *seg = m_segments.data() + idx;
+        return search<false>([this](size_t i) { return m_data[i].first; }, key, seg, EPSILON);
+    }
+
+    /*
+     * Returns the record at position idx, in key order, or nullptr if idx
+     * is out of range.
+     */
+    const R *get_record_at(size_t idx) {
+        return (idx < m_data.size()) ? m_data.data() + idx : nullptr;
+    }
+
+    size_t record_count() {
+        return m_data.size();
+    }
+
+    /*
+     * Returns the number of segments on the lowest level, which cover the
+     * records themselves.
+     */
+    size_t segment_count() {
+        if (m_level_offsets.size() == 0) {
+            return 0;
+        }
+
+        return ((m_level_offsets.size() > 1) ? m_level_offsets[1] : m_segments.size()) - 1;
+    }
+
+    /*
+     * Returns the number of levels of segments.
+     */
+    size_t height() {
+        return m_level_offsets.size();
+    }
+
+    /*
+     * Returns the number of bytes used by the segments.
+     */
+    size_t index_memory_usage() {
+        return m_segments.size() * sizeof(segment) + m_level_offsets.size() * sizeof(size_t);
+    }
+
+private:
+    std::vector<R> m_data;
+
+    /*
+     * The segments of every level, including their sentinels, stored
+     * contiguously from the bottom level up, and the offset of each level
+     * within them.
+     */
+    std::vector<segment> m_segments;
+    std::vector<size_t> m_level_offsets;
+
+    PGMIndex(std::vector<R> &records) {
+        m_data = std::move(records);
+
+        if (m_data.size() > 0) {
+            build_levels();
+        }
+    }
+
+    void build_levels() {
+        fit_segments([this](size_t i) { return m_data[i].first; }, m_data.size(), EPSILON, m_segments);
+        m_level_offsets.push_back(0);
+
+        std::vector<segment> level;
+        while (m_segments.size() - m_level_offsets.back() > 2) {
+            const segment *below = m_segments.data() + m_level_offsets.back();
+            size_t below_cnt = m_segments.size() - m_level_offsets.back() - 1;
+
+            level.clear();
+            fit_segments([below](size_t i) { return below[i].key; }, below_cnt, EPSILON_RECURSIVE, level);
+
+            m_level_offsets.push_back(m_segments.size());
+            m_segments.insert(m_segments.end(), level.begin(), level.end());
+        }
+    }
+
+    /*
+     * Cover the sorted keys key_at(0), ..., key_at(cnt - 1) with segments
+     * that predict the position of the first copy of each key to within
+     * eps, appending them, followed by a sentinel, to segs.
+     *
+     * A segment starting at the point (x0, y0) can include the point (x, y)
+     * only if its slope lies within [(y - eps - y0) / (x - x0),
+     * (y + eps - y0) / (x - x0)]. The intersection of these ranges over the
+     * points added so far forms a cone of valid slopes, which shrinks as
+     * points are added; once it is empty, a new segment is started.
+     */
+    template <typename KeyFn>
+    static void fit_segments(KeyFn key_at, size_t cnt, size_t eps, std::vector<segment> &segs) {
+        K x0 = key_at(0);
+        size_t y0 = 0;
+        double lo = 0;
+        double hi = std::numeric_limits<double>::infinity();
+
+        auto close_segment = [&]() {
+            double slope = (hi == std::numeric_limits<double>::infinity()) ? 0 : (lo + hi) / 2;
+            segs.push_back({x0, slope, y0});
+        };
+
+        for (size_t i=1; i<cnt; i++) {
+            K x = key_at(i);
+            if (x == key_at(i - 1)) {
+                continue;
+            }
+
+            double dx = key_delta(x, x0);
+            double dy = (double) i - (double) y0;
+            double l = (dy - (double) eps) / dx;
+            double h = (dy + (double) eps) / dx;
+
+            if (l > hi || h < lo) {
+                close_segment();
+                x0 = x;
+                y0 = i;
+                lo = 0;
+                hi = std::numeric_limits<double>::infinity();
+            } else {
+                lo = std::max(lo, l);
+                hi = std::min(hi, h);
+            }
+        }
+
+        close_segment();
+        segs.push_back({max_key(), 0, cnt});
+    }
+
+    /*
+     * Search the entries covered by seg for key, returning the index of the
+     * first entry whose key is greater than key (if UPPER), or not less than
+     * key (otherwise). Only a window of about 2 * eps entries around the
+     * predicted position is searched. Floating point error can push the
+     * prediction slightly outside of its bound, so if the window turns out
+     * not to contain the answer, the remainder of the segment is searched.
+     */
+    template <bool UPPER, typename KeyFn>
+    static size_t search(KeyFn key_at, K key, const segment *seg, size_t eps) {
+        size_t lo = seg->pos;
+        size_t hi = (seg + 1)->pos;
+
+        auto before = [&](size_t i) {
+            if constexpr (UPPER) {
+                return key_at(i) <= key;
+            } else {
+                return key_at(i) < key;
+            }
+        };
+
+        auto partition = [&](size_t first, size_t last) {
+            while (first < last) {
+                size_t mid = first + (last - first) / 2;
+                if (before(mid)) {
+                    first = mid + 1;
+                } else {
+                    last = mid;
+                }
+            }
+
+            return first;
+        };
+
+        double est = seg->slope * key_delta(key, seg->key);
+        size_t pos = (est < (double) (hi - lo)) ? lo + (size_t) est : hi;
+
+        size_t win_lo = (pos > lo + eps) ? pos - eps : lo;
+        size_t win_hi = std::min(hi, pos + eps + 2);
+
+        size_t idx = partition(win_lo, win_hi);
+        if (idx == win_lo && win_lo > lo && !before(win_lo - 1)) {
+            return partition(lo, win_lo);
+        } else if (idx == win_hi && win_hi < hi && before(win_hi)) {
+            return partition(win_hi, hi);
+        }
+
+        return idx;
+    }
+
+    /*
+     * Returns key - base, which must not be negative, as a double. Integer
+     * keys are subtracted as unsigned values, so that the difference cannot
+     * overflow.
+     */
+    static double key_delta(K key, K base) {
+        if constexpr (std::is_integral_v<K>) {
+            typedef std::make_unsigned_t<K> U;
+            return (double) (U) ((U) key - (U) base);
+        } else {
+            return (double) key - (double) base;
+        }
+    }
+
+    static constexpr K max_key() {
+        if constexpr (std::numeric_limits<K>::has_infinity) {
+            return std::numeric_limits<K>::infinity();
+        } else {
+            return std::numeric_limits<K>::max();
+        }
+    }
+};
+
+}
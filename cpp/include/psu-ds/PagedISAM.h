@@ -0,0 +1,533 @@
+/*
+ * psu-ds/PagedISAM.h
+ *
+ * Copyright (C) 2023-2024 Douglas B. Rumbaugh <drumbaugh@psu.edu)
+ * Distributed under the Modified BSD License.
+ *
+ * A static ISAM tree stored within a PagedFile, for data sets too large
+ * to be held in memory. The tree is bulk-loaded from sorted records, and
+ * is laid out within the file as a metadata page, followed by the leaf
+ * pages in key order, followed by the internal levels from the bottom up.
+ * Nodes refer to their children by PageNum, so the tree can be reopened
+ * from its metadata page.
+ *
+ * Point lookups require one read per level of the tree, and range queries
+ * then read the following leaves sequentially. The internal levels can
+ * optionally be pinned in memory, in which case a lookup requires only a
+ * single read, of the leaf.
+ *
+ * Construction requires the pages of the tree to be allocated contiguously,
+ * so no other allocations may be made from the file during a build. Queries
+ * are thread-safe.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+#include "psu-util/alignment.h"
+#include "psu-io/IOTypes.h"
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+
+namespace psudb {
+
+template <typename K, typename V>
+class PagedISAMTree {
+public:
+    typedef std::pair<K, V> R;
+
+    struct RangeQueryParameters {
+        K lower_bound;
+        K upper_bound;
+    };
+
+private:
+    static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+                  "Keys and values must be trivially copyable to be stored in pages");
+    static_assert(alignof(R) <= 8, "Records must not require more than 8 byte alignment");
+
+    static const uint32_t ISAM_MAGIC = 0x50534953;
+
+    /* the number of pages read, or written, by a single IO */
+    static constexpr size_t IO_BATCH = 64;
+
+    struct meta_header {
+        uint32_t magic;
+        uint32_t height;
+        uint32_t key_size;
+        uint32_t rec_size;
+        PageNum root;
+        PageNum first_leaf;
+        PageNum leaf_cnt;
+        PageNum first_inode;
+        PageNum inode_cnt;
+        uint64_t rec_cnt;
+    };
+
+    /*
+     * Every node begins with this header. Leaves are at level 0, and hold
+     * an array of records. Internal nodes hold an array of separator keys,
+     * each the smallest key beneath the corresponding child, followed by
+     * an array of the children's PageNums.
+     */
+    struct node_header {
+        uint32_t count;
+        uint32_t level;
+    };
+
+    struct buffer_deleter {
+        void operator()(byte *ptr) const { free(ptr); }
+    };
+
+    typedef std::unique_ptr<byte, buffer_deleter> page_buffer;
+
+public:
+    /*
+     * Build a new tree within pfile from records, which are sorted in
+     * place. Returns nullptr if the tree could not be written.
+     */
+    static std::unique_ptr<PagedISAMTree> build(PagedFile *pfile, std::vector<R> &records, bool pin_internal=false) {
+        std::sort(records.begin(), records.end());
+        return build_presorted(pfile, records.begin(), records.end(), pin_internal);
+    }
+
+    /*
+     * Build a new tree within pfile from the records in [begin, end), which
+     * must already be sorted by key. The records are consumed as a stream,
+     * and so need not fit in memory; only the smallest key of each leaf is
+     * retained during construction. Returns nullptr if the tree could not
+     * be written.
+     */
+    template <typename InputIt>
+    static std::unique_ptr<PagedISAMTree> build_presorted(PagedFile *pfile, InputIt begin, InputIt end, bool pin_internal=false) {
+        auto tree = std::unique_ptr<PagedISAMTree>(new PagedISAMTree(pfile));
+
+        PageNum meta_pnum = pfile->allocate_pages(1);
+        if (meta_pnum == INVALID_PNUM) {
+            return nullptr;
+        }
+
+        tree->m_meta_pnum = meta_pnum;
+        page_writer writer(pfile, meta_pnum + 1);
+        std::vector<K> separators;
+
+        if (!tree->write_leaves(writer, begin, end, separators) || !tree->write_internal_levels(writer, separators)
+            || !writer.flush() || !tree->write_meta()) {
+            return nullptr;
+        }
+
+        if (pin_internal && !tree->pin_internal_levels()) {
+            return nullptr;
+        }
+
+        return tree;
+    }
+
+    /*
+     * Open an existing tree within pfile, given the PageNum of its metadata
+     * page. Returns nullptr if meta_pnum does not refer to a tree with the
+     * same key and record types.
+     */
+    static std::unique_ptr<PagedISAMTree> open(PagedFile *pfile, PageNum meta_pnum, bool pin_internal=false) {
+        auto tree = std::unique_ptr<PagedISAMTree>(new PagedISAMTree(pfile));
+        page_buffer buffer(sf_aligned_alloc(SECTOR_SIZE, pfile->get_page_size()));
+
+        if (!pfile->read_page(meta_pnum, buffer.get())) {
+            return nullptr;
+        }
+
+        memcpy(&tree->m_meta, buffer.get(), sizeof(meta_header));
+        if (tree->m_meta.magic != ISAM_MAGIC || tree->m_meta.key_size != sizeof(K) || tree->m_meta.rec_size != sizeof(R)) {
+            return nullptr;
+        }
+
+        tree->m_meta_pnum = meta_pnum;
+        if (pin_internal && !tree->pin_internal_levels()) {
+            return nullptr;
+        }
+
+        return tree;
+    }
+
+    ~PagedISAMTree() {
+        free(m_pinned);
+    }
+
+    /*
+     * Find the first record with a key greater than or equal to key, and
+     * copy it into result. Returns 1 if such a record exists, and 0 if it
+     * does not, or if an IO error occurs.
+     */
+    int lower_bound(const K &key, R *result) {
+        page_buffer buffer(sf_aligned_alloc(SECTOR_SIZE, m_page_size));
+
+        PageNum leaf;
+        size_t idx;
+        if (!find_leaf(key, buffer.get(), &leaf, &idx)) {
+            return 0;
+        }
+
+        *result = leaf_records(buffer.get())[idx];
+        return 1;
+    }
+
+    /*
+     * Returns all records with keys in the range [lower_bound, upper_bound).
+     */
+    std::vector<R> query(void *q) {
+        std::vector<R> rs;
+
+        /* return an empty result set if q is invalid */
+        if (q == nullptr) {
+            return rs;
+        }
+
+        auto parms = (PagedISAMTree::RangeQueryParameters*) q;
+        page_buffer buffer(sf_aligned_alloc(SECTOR_SIZE, IO_BATCH * m_page_size));
+
+        PageNum leaf;
+        size_t idx;
+        if (!find_leaf(parms->lower_bound, buffer.get(), &leaf, &idx)) {
+            return rs;
+        }
+
+        PageNum last_leaf = m_meta.first_leaf + m_meta.leaf_cnt - 1;
+        size_t batch_cnt = 1;
+        size_t batch_idx = 0;
+
+        while (true) {
+            const byte *page = get_page(buffer.get(), batch_idx, m_page_size);
+            const R *recs = leaf_records(page);
+            size_t cnt = header(page)->count;
+
+            for (; idx < cnt; idx++) {
+                if (!(recs[idx].first < parms->upper_bound)) {
+                    return rs;
+                }
+
+                rs.emplace_back(recs[idx]);
+            }
+
+            if (leaf == last_leaf) {
+                break;
+            }
+
+            leaf++;
+            idx = 0;
+
+            /* the following leaves are contiguous, so read them in batches */
+            if (++batch_idx == batch_cnt) {
+                batch_cnt = std::min<size_t>(IO_BATCH, last_leaf - leaf + 1);
+                batch_idx = 0;
+                if (!m_pfile->read_pages(leaf, batch_cnt, buffer.get())) {
+                    break;
+                }
+            }
+        }
+
+        return rs;
+    }
+
+    std::vector<R> query_merge(std::vector<R> &rsa, std::vector<R> &rsb) {
+        rsa.insert(rsa.end(), rsb.begin(), rsb.end());
+        return std::move(rsa);
+    }
+
+    size_t record_count() const {
+        return m_meta.rec_cnt;
+    }
+
+    size_t leaf_count() const {
+        return m_meta.leaf_cnt;
+    }
+
+    size_t internal_node_count() const {
+        return m_meta.inode_cnt;
+    }
+
+    /*
+     * Returns the number of levels in the tree, including the leaves. Point
+     * lookups require this many reads if the internal levels are not
+     * pinned.
+     */
+    size_t height() const {
+        return m_meta.height;
+    }
+
+    bool is_pinned() const {
+        return m_pinned != nullptr;
+    }
+
+    /*
+     * Returns the metadata page of the tree, which is needed to reopen it.
+     */
+    PageNum get_meta_page() const {
+        return m_meta_pnum;
+    }
+
+private:
+    PagedFile *m_pfile;
+    size_t m_page_size;
+    size_t m_leaf_cap;
+    size_t m_fanout;
+    size_t m_ptr_offset;
+    PageNum m_meta_pnum;
+    meta_header m_meta;
+    byte *m_pinned;
+
+    /*
+     * Hands out zeroed page buffers in order, writing them back in batches.
+     * The pages are allocated from the file when written, and must be
+     * contiguous with those written before, starting at first_pnum.
+     */
+    class page_writer {
+    public:
+        page_writer(PagedFile *pfile, PageNum first_pnum)
+          : m_pfile(pfile), m_page_size(pfile->get_page_size()), m_next_pnum(first_pnum), m_used(0)
+          , m_buffer(sf_aligned_alloc(SECTOR_SIZE, IO_BATCH * m_page_size)) {}
+
+        /*
+         * Returns the next page, or nullptr if the previous batch could not
+         * be written.
+         */
+        byte *next_page() {
+            if (m_used == IO_BATCH && !flush()) {
+                return nullptr;
+            }
+
+            byte *page = get_page(m_buffer.get(), m_used++, m_page_size);
+            memset(page, 0, m_page_size);
+            m_next_pnum++;
+
+            return page;
+        }
+
+        /*
+         * Returns the PageNum that the next page will be written to.
+         */
+        PageNum next_pnum() const {
+            return m_next_pnum;
+        }
+
+        int flush() {
+            if (m_used == 0) {
+                return 1;
+            }
+
+            PageNum first = m_pfile->allocate_pages(m_used);
+            if (first != m_next_pnum - m_used || !m_pfile->write_pages(first, m_used, m_buffer.get())) {
+                return 0;
+            }
+
+            m_used = 0;
+            return 1;
+        }
+
+    private:
+        PagedFile *m_pfile;
+        size_t m_page_size;
+        PageNum m_next_pnum;
+        size_t m_used;
+        page_buffer m_buffer;
+    };
+
+    PagedISAMTree(PagedFile *pfile)
+      : m_pfile(pfile)
+      , m_page_size(pfile->get_page_size())
+      , m_leaf_cap((pfile->get_payload_size() - sizeof(node_header)) / sizeof(R))
+      , m_fanout((pfile->get_payload_size() - 2 * sizeof(node_header)) / (sizeof(K) + sizeof(PageNum)))
+      , m_ptr_offset(MAXALIGN(sizeof(node_header) + m_fanout * sizeof(K)))
+      , m_meta_pnum(INVALID_PNUM)
+      , m_meta({ISAM_MAGIC, 0, sizeof(K), sizeof(R), INVALID_PNUM, INVALID_PNUM, 0, INVALID_PNUM, 0, 0})
+      , m_pinned(nullptr) {}
+
+    static node_header *header(byte *page) {
+        return (node_header *) page;
+    }
+
+    static const node_header *header(const byte *page) {
+        return (const node_header *) page;
+    }
+
+    static R *leaf_records(byte *page) {
+        return (R *) (page + sizeof(node_header));
+    }
+
+    static const R *leaf_records(const byte *page) {
+        return (const R *) (page + sizeof(node_header));
+    }
+
+    K *node_keys(byte *page) const {
+        return (K *) (page + sizeof(node_header));
+    }
+
+    const K *node_keys(const byte *page) const {
+        return (const K *) (page + sizeof(node_header));
+    }
+
+    PageNum *node_ptrs(byte *page) const {
+        return (PageNum *) (page + m_ptr_offset);
+    }
+
+    const PageNum *node_ptrs(const byte *page) const {
+        return (const PageNum *) (page + m_ptr_offset);
+    }
+
+    template <typename InputIt>
+    int write_leaves(page_writer &writer, InputIt begin, InputIt end, std::vector<K> &separators) {
+        m_meta.first_leaf = writer.next_pnum();
+
+        byte *page = nullptr;
+        for (auto itr = begin; itr != end; ++itr) {
+            if (page == nullptr || header(page)->count == m_leaf_cap) {
+                if (!(page = writer.next_page())) {
+                    return 0;
+                }
+
+                separators.push_back(itr->first);
+                m_meta.leaf_cnt++;
+            }
+
+            leaf_records(page)[header(page)->count++] = *itr;
+            m_meta.rec_cnt++;
+        }
+
+        return 1;
+    }
+
+    /*
+     * Build the internal levels from the bottom up, based on the separator
+     * keys of the level below. Each level is written contiguously, so the
+     * children of a level are the pages of the level below it in order.
+     */
+    int write_internal_levels(page_writer &writer, std::vector<K> &separators) {
+        if (m_meta.leaf_cnt == 0) {
+            return 1;
+        }
+
+        m_meta.first_inode = writer.next_pnum();
+
+        PageNum child_first = m_meta.first_leaf;
+        size_t child_cnt = m_meta.leaf_cnt;
+        uint32_t level = 0;
+
+        while (child_cnt > 1) {
+            level++;
+            PageNum level_first = writer.next_pnum();
+            std::vector<K> next_separators;
+
+            byte *page = nullptr;
+            for (size_t i=0; i<child_cnt; i++) {
+                if (i % m_fanout == 0) {
+                    if (!(page = writer.next_page())) {
+                        return 0;
+                    }
+
+                    header(page)->level = level;
+                    next_separators.push_back(separators[i]);
+                }
+
+                node_keys(page)[i % m_fanout] = separators[i];
+                node_ptrs(page)[i % m_fanout] = child_first + i;
+                header(page)->count++;
+            }
+
+            child_first = level_first;
+            child_cnt = next_separators.size();
+            m_meta.inode_cnt += child_cnt;
+            separators = std::move(next_separators);
+        }
+
+        m_meta.root = child_first;
+        m_meta.height = level + 1;
+
+        return 1;
+    }
+
+    int write_meta() {
+        page_buffer buffer(sf_aligned_alloc(SECTOR_SIZE, m_page_size));
+        memset(buffer.get(), 0, m_page_size);
+        memcpy(buffer.get(), &m_meta, sizeof(meta_header));
+
+        return m_pfile->write_page(m_meta_pnum, buffer.get());
+    }
+
+    int pin_internal_levels() {
+        if (m_meta.inode_cnt == 0) {
+            return 1;
+        }
+
+        m_pinned = sf_aligned_alloc(SECTOR_SIZE, m_meta.inode_cnt * m_page_size);
+        for (size_t i=0; i<m_meta.inode_cnt; i+=IO_BATCH) {
+            size_t cnt = std::min<size_t>(IO_BATCH, m_meta.inode_cnt - i);
+            if (!m_pfile->read_pages(m_meta.first_inode + i, cnt, get_page(m_pinned, i, m_page_size))) {
+                free(m_pinned);
+                m_pinned = nullptr;
+                return 0;
+            }
+        }
+
+        return 1;
+    }
+
+    /*
+     * Locate the first record with a key greater than or equal to key. On
+     * success, its leaf is read into buffer, and its PageNum and index within
+     * the leaf are returned. Returns 0 if there is no such record, or if an
+     * IO error occurs.
+     */
+    int find_leaf(const K &key, byte *buffer, PageNum *leaf, size_t *idx) {
+        if (m_meta.leaf_cnt == 0) {
+            return 0;
+        }
+
+        PageNum pnum = m_meta.root;
+        for (size_t level = m_meta.height - 1; level > 0; level--) {
+            const byte *node = buffer;
+            if (m_pinned) {
+                node = get_page(m_pinned, pnum - m_meta.first_inode, m_page_size);
+            } else if (!m_pfile->read_page(pnum, buffer)) {
+                return 0;
+            }
+
+            /*
+             * Descend into the last child whose smallest key is less than
+             * key. Every later child begins with a key no smaller than key,
+             * so the lower bound is within this child, or is the first
+             * record following it.
+             */
+            const K *keys = node_keys(node);
+            size_t i = std::lower_bound(keys, keys + header(node)->count, key) - keys;
+            pnum = node_ptrs(node)[(i == 0) ? 0 : i - 1];
+        }
+
+        if (!m_pfile->read_page(pnum, buffer)) {
+            return 0;
+        }
+
+        const R *recs = leaf_records(buffer);
+        size_t cnt = header(buffer)->count;
+        *idx = std::lower_bound(recs, recs + cnt, key, [](const R &rec, const K &k) { return rec.first < k; }) - recs;
+
+        /*
+         * If every record in the leaf is smaller than key, the lower bound
+         * is the first record of the next leaf, if there is one.
+         */
+        if (*idx == cnt) {
+            if (pnum == m_meta.first_leaf + m_meta.leaf_cnt - 1 || !m_pfile->read_page(++pnum, buffer)) {
+                return 0;
+            }
+
+            *idx = 0;
+        }
+
+        *leaf = pnum;
+        return 1;
+    }
+};
+
+}
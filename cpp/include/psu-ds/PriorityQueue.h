@@ -11,7 +11,12 @@
  */
 #pragma once
 
+#include <sys/types.h>
+
+#include <cstddef>
 #include <vector>
+#include <algorithm>
+#include <iterator>
 #include <cassert>
 
 namespace psudb {
@@ -161,4 +166,115 @@ private:
         }
     }
 };
+
+/*
+ * The number of records below which kway_merge simply sorts the runs.
+ */
+const size_t KWAY_MERGE_MIN_ELEMENTS = 64;
+
+/*
+ * Merge the sorted runs into a single sorted vector, using a PriorityQueue
+ * over the smallest remaining record of each run. The merge is stable:
+ * records that are equivalent under operator< are taken from earlier runs
+ * first. The runs are left empty.
+ */
+template <typename R>
+std::vector<R> kway_merge(std::vector<std::vector<R>> &runs) {
+    size_t total = 0;
+    for (auto &run : runs) {
+        total += run.size();
+    }
+
+    std::vector<R> merged;
+
+    /* most small reconstructions only involve one or two runs */
+    size_t nonempty = 0;
+    size_t first = 0, second = 0;
+    for (size_t i=0; i<runs.size(); i++) {
+        if (runs[i].size() > 0) {
+            (nonempty++ == 0 ? first : second) = i;
+        }
+    }
+
+    if (nonempty <= 2) {
+        if (nonempty == 1) {
+            merged = std::move(runs[first]);
+        } else if (nonempty == 2) {
+            auto &a = runs[first];
+            auto &b = runs[second];
+
+            merged.reserve(total);
+            std::merge(std::make_move_iterator(a.begin()), std::make_move_iterator(a.end()),
+                       std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()),
+                       std::back_inserter(merged));
+        }
+
+        for (auto &run : runs) {
+            std::vector<R>().swap(run);
+        }
+
+        return merged;
+    }
+
+    merged.reserve(total);
+
+    /* for only a handful of records, sorting is cheaper than the queue */
+    if (total <= KWAY_MERGE_MIN_ELEMENTS) {
+        for (auto &run : runs) {
+            merged.insert(merged.end(), std::make_move_iterator(run.begin()), std::make_move_iterator(run.end()));
+            std::vector<R>().swap(run);
+        }
+
+        std::stable_sort(merged.begin(), merged.end());
+        return merged;
+    }
+
+    /*
+     * The queue only consults its version when two entries are the same
+     * record, so each run's head is wrapped in an entry which itself
+     * breaks ties between equivalent records by run index. Each run has at
+     * most one entry in the queue at a time.
+     */
+    struct run_head {
+        const R *rec;
+        size_t run;
+
+        bool operator<(const run_head &other) const {
+            if (*rec < *other.rec) {
+                return true;
+            } else if (*other.rec < *rec) {
+                return false;
+            }
+
+            return run < other.run;
+        }
+    };
+
+    PriorityQueue<run_head> pq(runs.size());
+    std::vector<run_head> heads(runs.size());
+    std::vector<size_t> pos(runs.size(), 0);
+    for (size_t i=0; i<runs.size(); i++) {
+        if (runs[i].size() > 0) {
+            heads[i] = {runs[i].data(), i};
+            pq.push(&heads[i]);
+        }
+    }
+
+    while (pq.size() > 0) {
+        size_t i = pq.peek().data->run;
+        pq.pop();
+
+        merged.push_back(std::move(runs[i][pos[i]]));
+        if (++pos[i] < runs[i].size()) {
+            heads[i].rec = runs[i].data() + pos[i];
+            pq.push(&heads[i]);
+        }
+    }
+
+    for (auto &run : runs) {
+        std::vector<R>().swap(run);
+    }
+
+    return merged;
+}
 }
@@ -6,6 +6,29 @@
  *
  * A simple map implementation based on an in-memory, static ISAM tree 
  *
+ * The internal levels of the tree can be stored in one of three layouts,
+ * selected by the LAYOUT template parameter,
+ *
+ *   EXPLICIT:  each internal node stores its separator keys alongside
+ *              pointers to its children.
+ *   IMPLICIT:  internal nodes store only their keys, packed contiguously
+ *              level by level, and the position of a child is computed
+ *              from that of its parent, as in a CSS-tree. This halves the
+ *              size of the index for 8 byte keys, and with a FANOUT of
+ *              CACHELINE_SIZE / sizeof(K), each node is one cache line.
+ *   EYTZINGER: the lowest internal level is stored as in IMPLICIT, and the
+ *              levels above it are replaced by a single array of that
+ *              level's separator keys in Eytzinger (breadth-first) order,
+ *              which is searched with a branch-free binary search that
+ *              prefetches several levels ahead.
+ *
+ * The IMPLICIT and EYTZINGER layouts require arithmetic keys.
+ *
+ * If an ArenaPool is supplied when the tree is built, the records and the
+ * internal levels are placed together in a single arena from the pool,
+ * rather than in separate heap allocations. The arena may be backed by
+ * huge pages, reducing TLB misses during lookups, and is returned to the
+ * pool for reuse when the tree is destroyed.
  */
 #pragma once
 
@@ -14,12 +37,130 @@
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <memory>
+#include <span>
+#include <limits>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #include "psu-util/alignment.h"
+#include "psu-util/parallel.h"
+#include "psu-util/arena.h"
+#include "psu-ds/PriorityQueue.h"
 
 namespace psudb {
 
-template <typename K, typename V, size_t FANOUT=64>
+#if defined(__x86_64__)
+/*
+ * Count the keys in the sorted array keys[0, n) that are less than key,
+ * for 4 and 8 byte integer and floating point keys, using AVX2 compares.
+ * The search stops at the first vector containing a key that is not less
+ * than key, so that later cache lines are not touched. n must be a
+ * multiple of the number of keys in a 32 byte vector. Must only be called
+ * if the CPU supports AVX2.
+ */
+template <typename K>
+__attribute__((target("avx2")))
+inline size_t count_less_avx2(const K *keys, size_t n, K key)
+{
+    size_t cnt = 0;
+
+    if constexpr (std::is_same_v<K, float>) {
+        __m256 k = _mm256_set1_ps(key);
+        for (size_t i=0; i<n; i+=8) {
+            int lt = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(keys + i), k, _CMP_LT_OQ));
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFF) break;
+        }
+    } else if constexpr (std::is_same_v<K, double>) {
+        __m256d k = _mm256_set1_pd(key);
+        for (size_t i=0; i<n; i+=4) {
+            int lt = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(keys + i), k, _CMP_LT_OQ));
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xF) break;
+        }
+    } else if constexpr (sizeof(K) == 4) {
+        /* AVX2 only has signed compares, so flip the sign bit of unsigned keys */
+        __m256i bias = _mm256_set1_epi32(std::is_signed_v<K> ? 0 : INT32_MIN);
+        __m256i k = _mm256_xor_si256(_mm256_set1_epi32((int32_t) key), bias);
+        for (size_t i=0; i<n; i+=8) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (keys + i)), bias);
+            int lt = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFF) break;
+        }
+    } else {
+        __m256i bias = _mm256_set1_epi64x(std::is_signed_v<K> ? 0 : INT64_MIN);
+        __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((int64_t) key), bias);
+        for (size_t i=0; i<n; i+=4) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (keys + i)), bias);
+            int lt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xF) break;
+        }
+    }
+
+    return cnt;
+}
+
+
+/*
+ * As count_less_avx2, but using AVX-512 compares on 64 byte vectors. Must
+ * only be called if the CPU supports AVX-512F.
+ */
+template <typename K>
+__attribute__((target("avx512f")))
+inline size_t count_less_avx512(const K *keys, size_t n, K key)
+{
+    size_t cnt = 0;
+
+    if constexpr (std::is_same_v<K, float>) {
+        __m512 k = _mm512_set1_ps(key);
+        for (size_t i=0; i<n; i+=16) {
+            __mmask16 lt = _mm512_cmp_ps_mask(_mm512_loadu_ps(keys + i), k, _CMP_LT_OQ);
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFFFF) break;
+        }
+    } else if constexpr (std::is_same_v<K, double>) {
+        __m512d k = _mm512_set1_pd(key);
+        for (size_t i=0; i<n; i+=8) {
+            __mmask8 lt = _mm512_cmp_pd_mask(_mm512_loadu_pd(keys + i), k, _CMP_LT_OQ);
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFF) break;
+        }
+    } else if constexpr (sizeof(K) == 4) {
+        __m512i k = _mm512_set1_epi32((int32_t) key);
+        for (size_t i=0; i<n; i+=16) {
+            __m512i v = _mm512_loadu_si512(keys + i);
+            __mmask16 lt = std::is_signed_v<K> ? _mm512_cmplt_epi32_mask(v, k) : _mm512_cmplt_epu32_mask(v, k);
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFFFF) break;
+        }
+    } else {
+        __m512i k = _mm512_set1_epi64((int64_t) key);
+        for (size_t i=0; i<n; i+=8) {
+            __m512i v = _mm512_loadu_si512(keys + i);
+            __mmask8 lt = std::is_signed_v<K> ? _mm512_cmplt_epi64_mask(v, k) : _mm512_cmplt_epu64_mask(v, k);
+            cnt += __builtin_popcount(lt);
+            if (lt != 0xFF) break;
+        }
+    }
+
+    return cnt;
+}
+#endif
+
+enum class ISAMLayout {
+    EXPLICIT,
+    IMPLICIT,
+    EYTZINGER
+};
+
+template <typename K, typename V, size_t FANOUT=64, ISAMLayout LAYOUT=ISAMLayout::EXPLICIT>
 class ISAMTree {
 private:
     typedef std::pair<K, V> R;
@@ -34,6 +175,47 @@ private:
     static_assert(FANOUT > 0 && (FANOUT & (FANOUT - 1)) == 0, "Fanout parameter must be a power of two");
     typedef internal_node inode;
 
+    /*
+     * Arithmetic keys are searched within internal nodes by counting the
+     * separators smaller than the search key, rather than by scanning for
+     * the first larger one. Unused separator slots are padded with the
+     * largest possible key so that they are never counted.
+     */
+    static constexpr bool counted_search = std::is_arithmetic_v<K>;
+
+    /*
+     * 4 and 8 byte arithmetic keys can be counted using SIMD compares, if
+     * a node's keys fill a whole number of vectors.
+     */
+    static constexpr bool simd_search = counted_search && (sizeof(K) == 4 || sizeof(K) == 8);
+
+    /*
+     * Leaves at least this large are searched with a binary search, rather
+     * than a linear scan.
+     */
+    static constexpr size_t LEAF_BINARY_SEARCH_FANOUT = 128;
+
+    static_assert(LAYOUT == ISAMLayout::EXPLICIT || counted_search, "Implicit layouts require arithmetic keys");
+
+    /*
+     * The number of Eytzinger array entries in a cache line. The descendants
+     * of entry k that are log2(EYTZINGER_BLOCK) levels below it occupy the
+     * cache line starting at entry k * EYTZINGER_BLOCK.
+     */
+    static constexpr size_t EYTZINGER_BLOCK = std::max<size_t>(CACHELINE_SIZE / sizeof(K), 1);
+
+    /*
+     * The number of lookups whose traversals are interleaved by
+     * lower_bound_batch.
+     */
+    static constexpr size_t BATCH_GROUP = 16;
+
+    /*
+     * The smallest number of internal nodes assigned to a thread when the
+     * internal levels are built in parallel.
+     */
+    static constexpr size_t PARALLEL_MIN_NODES = 1024;
+
 public:
     struct RangeQueryParameters {
         K lower_bound;
@@ -50,8 +232,60 @@ public:
         return new ISAMTree(records);
     }
 
+    /*
+     * Build the tree using up to thread_cnt threads, both to sort the
+     * records and to construct the internal levels. If pool is not null,
+     * the tree is stored in an arena allocated from it.
+     */
+    static ISAMTree *build(std::vector<R> &records, size_t thread_cnt, ArenaPool *pool=nullptr) {
+        psudb::parallel_sort(records.begin(), records.end(), thread_cnt);
+        return new ISAMTree(records, thread_cnt, pool);
+    }
+
+    static ISAMTree *build_presorted(std::vector<R> &records, size_t thread_cnt, ArenaPool *pool=nullptr) {
+        return new ISAMTree(records, thread_cnt, pool);
+    }
+
+    /*
+     * Build the tree from several runs of records, each of which is already
+     * sorted, by merging them using up to thread_cnt threads. A single
+     * thread merges all of the runs at once, with kway_merge. The runs are
+     * left empty.
+     */
+    static ISAMTree *build_from_runs(std::vector<std::vector<R>> &runs, size_t thread_cnt=1, ArenaPool *pool=nullptr) {
+        if (thread_cnt <= 1) {
+            auto records = kway_merge(runs);
+            return new ISAMTree(records, 1, pool);
+        }
+
+        std::vector<size_t> bounds = {0};
+        for (auto &run : runs) {
+            bounds.push_back(bounds.back() + run.size());
+        }
+
+        std::vector<R> records(bounds.back());
+        psudb::parallel_for(runs.size(), thread_cnt, [&](size_t start, size_t stop) {
+            for (size_t i=start; i<stop; i++) {
+                std::copy(runs[i].begin(), runs[i].end(), records.begin() + bounds[i]);
+                std::vector<R>().swap(runs[i]);
+            }
+        });
+
+        psudb::parallel_merge_runs(records.begin(), std::move(bounds), thread_cnt);
+        return new ISAMTree(records, thread_cnt, pool);
+    }
+
     std::vector<R> unbuild() {
-        return std::move(m_data);
+        std::vector<R> records;
+        if (m_arena) {
+            records.assign(std::make_move_iterator(m_records), std::make_move_iterator(m_records + m_record_cnt));
+            std::destroy_n(m_records, m_record_cnt);
+        } else {
+            records = std::move(m_data);
+        }
+
+        m_record_cnt = 0;
+        return records;
     }
 
     std::vector<R> query(void *q) {
@@ -63,14 +297,39 @@ public:
         }
 
         auto parms = (ISAMTree::RangeQueryParameters*) q;
+        auto records = range(parms->lower_bound, parms->upper_bound);
+
+        return std::vector<R>(records.begin(), records.end());
+    }
+
+    /*
+     * Returns a view of the records with keys in [lower, upper), without
+     * copying them. The view remains valid until the tree is unbuilt or
+     * destroyed.
+     */
+    std::span<const R> range(K lower, K upper) {
+        size_t start = lower_bound(lower);
+        size_t stop = (lower < upper) ? lower_bound(upper) : start;
 
-        size_t idx = lower_bound(parms->lower_bound);
+        return std::span<const R>(m_records + start, stop - start);
+    }
 
-        while (idx < m_data.size() && m_data[idx].first < parms->upper_bound) {
-            rs.emplace_back(m_data[idx++]);
+    /*
+     * Call visit(rec) on each record with a key in [lower, upper), in key
+     * order, stopping early if visit returns false. Returns the number of
+     * records visited.
+     */
+    template <typename F>
+    size_t visit_range(K lower, K upper, F &&visit) {
+        size_t cnt = 0;
+        for (size_t idx=lower_bound(lower); idx < m_record_cnt && m_records[idx].first < upper; idx++) {
+            cnt++;
+            if (!visit(m_records[idx])) {
+                break;
+            }
         }
 
-        return std::move(rs);
+        return cnt;
     }
 
     std::vector<R> query_merge(std::vector<R> &rsa, std::vector<R> &rsb) {
@@ -78,112 +337,366 @@ public:
         return std::move(rsa);
     }
 
+    /*
+     * Returns the index of the first record with a key greater than or
+     * equal to key, or record_count() if there is no such record.
+     */
+    size_t lower_bound(K key) {
+        /*
+         * If the tree is empty, just return 0. 
+         */
+        if (m_record_cnt == 0) {
+            return 0;
+        }
+
+        if constexpr (LAYOUT != ISAMLayout::EXPLICIT) {
+            return leaf_lower_bound(m_records + find_leaf(key) * FANOUT, key);
+        }
+
+        const inode *current = m_root;
+
+        /*
+         * Use the internal node separator keys to traverse the tree
+         * and identify the leaf node which will contain the lower bound
+         * on the requested key.
+         */
+        while (!is_leaf((byte *) current)) {
+            current = explicit_child(current, key);
+        }
+
+        /*
+         * If current falls within the leaf-node range, then it is
+         * safe to cast from an internal_node to a leaf node pointer.
+         */
+        return leaf_lower_bound((R *) current, key);
+    }
+
+    /*
+     * Find the lower bound of each of keys, as lower_bound, and store it in
+     * the corresponding entry of results, which must be at least as large.
+     * The traversals of groups of keys are interleaved to hide memory
+     * latency, so this is considerably faster than calling lower_bound for
+     * each key when the tree does not fit in cache.
+     */
+    void lower_bound_batch(std::span<const K> keys, std::span<size_t> results) {
+        assert(results.size() >= keys.size());
+
+        if (m_record_cnt == 0) {
+            std::fill(results.begin(), results.begin() + keys.size(), 0);
+            return;
+        }
+
+        for (size_t start=0; start<keys.size(); start+=BATCH_GROUP) {
+            size_t cnt = std::min(BATCH_GROUP, keys.size() - start);
+            lower_bound_group(keys.data() + start, results.data() + start, cnt);
+        }
+    }
+
+    /*
+     * Returns the record at position idx, in key order, or nullptr if idx
+     * is out of range.
+     */
+    const R *get_record_at(size_t idx) {
+        return (idx < m_record_cnt) ? m_records + idx : nullptr;
+    }
+
     size_t record_count() {
-        return m_data.size();
+        return m_record_cnt;
     }
 
+    /*
+     * Returns the number of internal nodes. For the EYTZINGER layout, only
+     * the nodes in the lowest internal level are counted.
+     */
     size_t internal_node_count() {
-        return m_root - m_inodes + 1 - (m_data.size() == 0);
+        if constexpr (LAYOUT == ISAMLayout::EXPLICIT) {
+            return m_root - m_inodes + 1 - (m_record_cnt == 0);
+        } else {
+            return m_inode_cnt;
+        }
+    }
+
+    /*
+     * Returns the number of bytes used by the internal levels of the tree.
+     */
+    size_t index_memory_usage() {
+        if constexpr (LAYOUT == ISAMLayout::EXPLICIT) {
+            return internal_node_count() * sizeof(inode);
+        } else {
+            return m_inode_cnt * FANOUT * sizeof(K) + (m_eytzinger_size + (m_eytzinger_size > 0)) * sizeof(K);
+        }
     }
 
     ~ISAMTree() {
-        free(m_inodes);
+        if (m_arena) {
+            std::destroy_n(m_records, m_record_cnt);
+            m_pool->release(m_arena);
+        } else {
+            free(m_inodes);
+            free(m_node_keys);
+            free(m_eytzinger);
+        }
     }
 
 
 private:
+    /*
+     * The records, in key order. They are owned by m_data, unless the
+     * tree is stored in an arena, in which case they are at its start.
+     */
     std::vector<R> m_data;
+    R *m_records;
+    size_t m_record_cnt;
+
+    /*
+     * The arena holding the records and internal levels, if any, the pool
+     * it came from, and the number of bytes of it used so far.
+     */
+    ArenaPool *m_pool;
+    byte *m_arena;
+    size_t m_arena_used;
     inode *m_root;
     inode *m_inodes;
 
-    ISAMTree(std::vector<R> &records) : m_inodes(nullptr), m_root(nullptr) {
-        m_data = std::move(records);
+    /*
+     * The keys of the internal nodes in the IMPLICIT and EYTZINGER layouts,
+     * and the offset (in nodes) of each level within them, from the root
+     * down.
+     */
+    K *m_node_keys;
+    std::vector<size_t> m_level_offsets;
+    size_t m_inode_cnt;
+
+    /*
+     * The Eytzinger array, indexed from 1. It is padded to a perfect tree
+     * with the largest key.
+     */
+    K *m_eytzinger;
+    size_t m_eytzinger_size;
+
+    ISAMTree(std::vector<R> &records, size_t thread_cnt=1, ArenaPool *pool=nullptr)
+        : m_records(nullptr), m_record_cnt(records.size()), m_pool(pool), m_arena(nullptr), m_arena_used(0)
+        , m_root(nullptr), m_inodes(nullptr), m_node_keys(nullptr), m_inode_cnt(0)
+        , m_eytzinger(nullptr), m_eytzinger_size(0) {
+
+        /*
+         * If the arena cannot be allocated, fall back to storing the tree
+         * on the heap.
+         */
+        if (m_pool && m_record_cnt > 0) {
+            m_arena_used = CACHELINEALIGN(m_record_cnt * sizeof(R));
+            m_arena = m_pool->allocate(m_arena_used + index_bytes(m_record_cnt));
+        }
+
+        if (m_arena) {
+            m_records = (R *) m_arena;
+            psudb::parallel_for(m_record_cnt, thread_cnt, [&](size_t start, size_t stop) {
+                std::uninitialized_move(records.begin() + start, records.begin() + stop, m_records + start);
+            }, PARALLEL_MIN_ELEMENTS);
 
-        if (m_data.size() > 0) {
-            m_root = build_internal_levels();
+            std::vector<R>().swap(records);
+        } else {
+            m_data = std::move(records);
+            m_records = m_data.data();
+        }
+
+        if (m_record_cnt > 0) {
+            if constexpr (LAYOUT == ISAMLayout::EXPLICIT) {
+                m_root = build_internal_levels(thread_cnt);
+            } else {
+                build_implicit_levels(thread_cnt);
+            }
         }
     }
 
     inline bool is_leaf(const byte *ptr) {
-        return ptr >= (byte *) m_data.begin().base() && ptr < (byte *) m_data.end().base();
+        return ptr >= (byte *) m_records && ptr < (byte *) (m_records + m_record_cnt);
     }
 
-    inode *build_internal_levels() {
+    inode *build_internal_levels(size_t thread_cnt) {
         /*
          * Allocate memory to store the internal nodes. These will all be stored contiguously
          * as an array; the ISAM Tree's index structure is static, so there's no need to use
          * a more flexible representation.
          */
-        size_t lnode_cnt = psudb::TYPEALIGN(leaf_sz, m_data.size() * sizeof(R)) / leaf_sz;
+        size_t lnode_cnt = psudb::TYPEALIGN(leaf_sz, m_record_cnt * sizeof(R)) / leaf_sz;
         size_t inode_cnt = required_internal_node_cnt(lnode_cnt, FANOUT);
-        m_inodes = (inode *) psudb::sf_aligned_calloc(psudb::CACHELINE_SIZE, inode_cnt, sizeof(inode));
+        m_inodes = (inode *) index_alloc(inode_cnt * sizeof(inode));
+        memset((void *) m_inodes, 0, inode_cnt * sizeof(inode));
 
         /*
-         * Construct the first level of internal nodes based upon the leaf data
+         * Construct the first level of internal nodes based upon the leaf data,
+         * and then each remaining level based on the separator keys in the level
+         * below, until a level consists of only the root. Each node's children
+         * are known in advance, so the nodes of a level are built in parallel.
          */
-        inode *cur_inode = m_inodes;
-        size_t i = 0;
-        for (auto itr = m_data.begin(); itr < m_data.end(); itr += FANOUT) {
-            (cur_inode->m_keys)[i] = itr->first;
-            (cur_inode->m_ptrs)[i] = (byte *) itr.base();
+        inode *level_start = m_inodes;
+        inode *level_stop = m_inodes + (lnode_cnt + FANOUT - 1) / FANOUT;
+
+        psudb::parallel_for(level_stop - level_start, thread_cnt, [&](size_t start, size_t stop) {
+            for (size_t j=start; j<stop; j++) {
+                init_inode(level_start + j, j, lnode_cnt, [&](size_t c) {
+                    R *leaf = m_records + c * FANOUT;
+                    return std::pair<K, byte *>(leaf->first, (byte *) leaf);
+                });
+            }
+        }, PARALLEL_MIN_NODES);
+
+        while (level_stop - level_start > 1) {
+            size_t child_cnt = level_stop - level_start;
+            size_t node_cnt = (child_cnt + FANOUT - 1) / FANOUT;
+
+            psudb::parallel_for(node_cnt, thread_cnt, [&](size_t start, size_t stop) {
+                for (size_t j=start; j<stop; j++) {
+                    init_inode(level_stop + j, j, child_cnt, [&](size_t c) {
+                        return std::pair<K, byte *>(level_start[c].m_keys[0], (byte *) (level_start + c));
+                    });
+                }
+            }, PARALLEL_MIN_NODES);
+
+            level_start = level_stop;
+            level_stop += node_cnt;
+        }
+
+        return level_start;
+    }
+
+    /*
+     * Fill in the j'th node of a level, whose children are the children
+     * j * FANOUT, ... of the child_cnt children of the level. child(c)
+     * returns the smallest key beneath child c, and a pointer to it.
+     */
+    template <typename ChildFn>
+    void init_inode(inode *node, size_t j, size_t child_cnt, ChildFn &&child) {
+        if constexpr (counted_search) {
+            node->m_keys.fill(max_key());
+        }
 
-            i = (i + 1) & (FANOUT - 1);
-            cur_inode += (i == 0);
+        for (size_t c=j * FANOUT; c < std::min((j + 1) * FANOUT, child_cnt); c++) {
+            auto [key, ptr] = child(c);
+            node->m_keys[c % FANOUT] = key;
+            node->m_ptrs[c % FANOUT] = ptr;
         }
+    }
 
+    void build_implicit_levels(size_t thread_cnt) {
         /*
-         * If there's only one internal node total, it is the root and so we
-         * are done. 
+         * Determine the number of nodes in each internal level, from the
+         * bottom up. In the EYTZINGER layout, only the lowest level is
+         * stored as nodes.
          */
-        if (inode_cnt == 1) {
-            return cur_inode - (i == 0);
+        size_t lnode_cnt = (m_record_cnt + FANOUT - 1) / FANOUT;
+        std::vector<size_t> level_cnts = implicit_level_cnts(m_record_cnt);
+        for (size_t cnt : level_cnts) {
+            m_inode_cnt += cnt;
         }
 
-        /* If we didn't fully fill the last node (in which case cur_inode
-         * is already pointing at the next empty internal node), advance to 
-         * the next internal node.
-         */
-        if (i > 0) cur_inode++;
+        m_node_keys = (K *) index_alloc(m_inode_cnt * FANOUT * sizeof(K));
+        psudb::parallel_for(m_inode_cnt * FANOUT, thread_cnt, [&](size_t start, size_t stop) {
+            std::fill(m_node_keys + start, m_node_keys + stop, max_key());
+        }, PARALLEL_MIN_NODES * FANOUT);
+
+        size_t offset = 0;
+        m_level_offsets.resize(level_cnts.size());
+        for (size_t i=0; i<level_cnts.size(); i++) {
+            m_level_offsets[i] = offset;
+            offset += level_cnts[level_cnts.size() - i - 1];
+        }
 
         /*
-         * Construct the remaining internal levels based on the separator keys
-         * in the level below.
+         * The children of a level are packed contiguously, so the keys of a
+         * level are simply the smallest key of each of its children, in
+         * order.
          */
-        inode *level_start = m_inodes;
-        inode *level_stop = cur_inode;
-        do {
-            i=0;
-            for (inode *itr = level_start + 1; itr < level_stop; itr++) {
-                cur_inode->m_keys[i] = (itr-1)->m_keys[0];
-                cur_inode->m_ptrs[i] = (byte *) (itr-1);
+        K *level = m_node_keys + m_level_offsets.back() * FANOUT;
+        psudb::parallel_for(lnode_cnt, thread_cnt, [&](size_t start, size_t stop) {
+            for (size_t i=start; i<stop; i++) {
+                level[i] = m_records[i * FANOUT].first;
+            }
+        }, PARALLEL_MIN_NODES * FANOUT);
 
-                i = (i + 1) & (FANOUT - 1);
-                cur_inode += (i == 0);
-            } 
+        for (size_t l=m_level_offsets.size() - 1; l > 0; l--) {
+            const K *children = m_node_keys + m_level_offsets[l] * FANOUT;
+            K *parents = m_node_keys + m_level_offsets[l-1] * FANOUT;
+            for (size_t i=0; i<level_cnts[m_level_offsets.size() - l - 1]; i++) {
+                parents[i] = children[i * FANOUT];
+            }
+        }
 
-            level_start = level_stop;
-            level_stop = cur_inode;
-        } while (level_stop - level_start + 1 > 1);
+        if constexpr (LAYOUT == ISAMLayout::EYTZINGER) {
+            std::vector<K> separators(level_cnts[0]);
+            for (size_t i=0; i<separators.size(); i++) {
+                separators[i] = level[i * FANOUT];
+            }
 
-        return cur_inode - (i == 0);
+            m_eytzinger_size = eytzinger_size(separators.size());
+            m_eytzinger = (K *) index_alloc((m_eytzinger_size + 1) * sizeof(K));
+            m_eytzinger[0] = max_key();
+            build_eytzinger(separators, 0, 1);
+        }
     }
 
-    size_t lower_bound(K key) {
-        /*
-         * If the tree is empty, just return 0. 
-         */
-        if (!m_root) {
-            return 0;
+    /*
+     * Fill the subtree of the Eytzinger array rooted at entry k with the
+     * separators, starting from separators[i], in order. Returns the index
+     * of the next separator to be placed.
+     */
+    size_t build_eytzinger(const std::vector<K> &separators, size_t i, size_t k) {
+        if (k <= m_eytzinger_size) {
+            i = build_eytzinger(separators, i, 2 * k);
+            m_eytzinger[k] = (i < separators.size()) ? separators[i] : max_key();
+            i = build_eytzinger(separators, i + 1, 2 * k + 1);
         }
 
-        const inode *current = m_root;
+        return i;
+    }
 
-        /*
-         * Use the internal node separator keys to traverse the tree
-         * and identify the leaf node which will contain the lower bound
-         * on the requested key.
-         */
-        while (!is_leaf((byte *) current)) {
+    /*
+     * Returns the index of the leaf node containing the lower bound of key,
+     * using one of the implicit layouts. This is the same leaf selected by
+     * the explicit layout.
+     */
+    size_t find_leaf(const K &key) {
+        size_t node = 0;
+
+        if constexpr (LAYOUT == ISAMLayout::EYTZINGER) {
+            /*
+             * The array is a perfect tree, so every search descends to the
+             * bottom, and the final position gives the number of separators
+             * smaller than key.
+             */
+            size_t k = 1;
+            while (k <= m_eytzinger_size) {
+                __builtin_prefetch(m_eytzinger + k * EYTZINGER_BLOCK);
+                k = 2 * k + (m_eytzinger[k] < key);
+            }
+
+            size_t cnt = k - (m_eytzinger_size + 1);
+            node = (cnt == 0) ? 0 : cnt - 1;
+        }
+
+        for (size_t offset : m_level_offsets) {
+            size_t cnt = count_less(m_node_keys + (offset + node) * FANOUT, key);
+            node = node * FANOUT + ((cnt == 0) ? 0 : cnt - 1);
+        }
+
+        return node;
+    }
+
+    /*
+     * Returns the child of an EXPLICIT layout internal node that contains
+     * the lower bound of key.
+     */
+    const inode *explicit_child(const inode *current, const K &key) {
+        if constexpr (counted_search) {
+            /*
+             * The index of the child to descend into is the number of
+             * separators, other than the first, that are smaller than
+             * key.
+             */
+            size_t cnt = count_less(current->m_keys.data(), key);
+            return (inode *) current->m_ptrs[(cnt == 0) ? 0 : cnt - 1];
+        } else {
             const byte *next = nullptr;
             // note: skip the last separator key, this case is handled
             // manually below
@@ -194,55 +707,223 @@ private:
                 }
             }
 
-            current = next ? (inode *) next : (inode *) current->m_ptrs[FANOUT-1];
+            return next ? (inode *) next : (inode *) current->m_ptrs[FANOUT-1];
         }
+    }
 
-        /*
-         * If current falls within the leaf-node range, then it is
-         * safe to cast from an internal_node to a leaf node pointer.
-         */
-        R *leaf_ptr = (R *) current;
+    /*
+     * Find the lower bounds of cnt keys, interleaving their traversals. At
+     * each level, every key takes one step and then prefetches the node it
+     * will visit next, so that the cache misses of the group overlap rather
+     * than forming one dependent chain per key. All of the leaves are at
+     * the same depth, so the keys remain in lockstep.
+     */
+    void lower_bound_group(const K *keys, size_t *results, size_t cnt) {
+        R *leaves[BATCH_GROUP];
+
+        if constexpr (LAYOUT == ISAMLayout::EXPLICIT) {
+            const inode *nodes[BATCH_GROUP];
+            std::fill(nodes, nodes + cnt, m_root);
+
+            while (!is_leaf((byte *) nodes[0])) {
+                for (size_t i=0; i<cnt; i++) {
+                    nodes[i] = explicit_child(nodes[i], keys[i]);
+                    prefetch(nodes[i], is_leaf((byte *) nodes[i]) ? leaf_sz : sizeof(K) * FANOUT);
+                }
+            }
+
+            for (size_t i=0; i<cnt; i++) {
+                leaves[i] = (R *) nodes[i];
+            }
+        } else {
+            size_t nodes[BATCH_GROUP] = {};
+
+            if constexpr (LAYOUT == ISAMLayout::EYTZINGER) {
+                size_t pos[BATCH_GROUP];
+                std::fill(pos, pos + cnt, 1);
+
+                for (size_t level=1; level<=m_eytzinger_size; level=2*level + 1) {
+                    for (size_t i=0; i<cnt; i++) {
+                        pos[i] = 2 * pos[i] + (m_eytzinger[pos[i]] < keys[i]);
+                        __builtin_prefetch(m_eytzinger + std::min(pos[i], m_eytzinger_size));
+                    }
+                }
+
+                for (size_t i=0; i<cnt; i++) {
+                    size_t less = pos[i] - (m_eytzinger_size + 1);
+                    nodes[i] = (less == 0) ? 0 : less - 1;
+                    prefetch(m_node_keys + nodes[i] * FANOUT, sizeof(K) * FANOUT);
+                }
+            }
+
+            for (size_t l=0; l<m_level_offsets.size(); l++) {
+                bool last = (l + 1 == m_level_offsets.size());
+                for (size_t i=0; i<cnt; i++) {
+                    size_t less = count_less(m_node_keys + (m_level_offsets[l] + nodes[i]) * FANOUT, keys[i]);
+                    nodes[i] = nodes[i] * FANOUT + ((less == 0) ? 0 : less - 1);
+
+                    if (last) {
+                        prefetch(m_records + nodes[i] * FANOUT, leaf_sz);
+                    } else {
+                        prefetch(m_node_keys + (m_level_offsets[l+1] + nodes[i]) * FANOUT, sizeof(K) * FANOUT);
+                    }
+                }
+            }
+
+            for (size_t i=0; i<cnt; i++) {
+                leaves[i] = m_records + nodes[i] * FANOUT;
+            }
+        }
+
+        for (size_t i=0; i<cnt; i++) {
+            results[i] = leaf_lower_bound(leaves[i], keys[i]);
+        }
+    }
+
+    static void prefetch(const void *ptr, size_t bytes) {
+        for (size_t offset=0; offset<bytes; offset+=CACHELINE_SIZE) {
+            __builtin_prefetch((const byte *) ptr + offset);
+        }
+    }
 
+    size_t leaf_lower_bound(R *leaf_ptr, const K &key) {
         /*
-         * Scan the leaf node for the lower bound on the record.
-         * FIXME: for larger fanouts, it may be more effective to
-         * do a binary search here. This could be a simple if constexpr
-         * substitution.
+         * Search the leaf node for the lower bound on the record. For
+         * large fanouts, this is done using a binary search. The lower
+         * bound may fall just past the end of the leaf, so the linear
+         * scan is used to finish up in either case.
          */
-        for (/* intentionally blank */; leaf_ptr < m_data.end().base(); leaf_ptr++) {
+        if constexpr (FANOUT >= LEAF_BINARY_SEARCH_FANOUT) {
+            R *leaf_end = std::min(leaf_ptr + FANOUT, m_records + m_record_cnt);
+            leaf_ptr = std::lower_bound(leaf_ptr, leaf_end, key, [](const R &rec, const K &k) { return rec.first < k; });
+        }
+
+        for (/* intentionally blank */; leaf_ptr < m_records + m_record_cnt; leaf_ptr++) {
             if (leaf_ptr->first >= key) {
                 break;
             }
         }
 
-        return leaf_ptr - m_data.data();
+        return leaf_ptr - m_records;
     }
 
 
+    static constexpr K max_key() {
+        if constexpr (std::numeric_limits<K>::has_infinity) {
+            return std::numeric_limits<K>::infinity();
+        } else {
+            return std::numeric_limits<K>::max();
+        }
+    }
+
     /*
-     * Determines the number of internal nodes required to build an ISAM Tree
-     * with specified fanout over a given number of leaf nodes. This function
-     * uses the formula for the sum of a geometric series of (1/f)^i to calculate 
-     * the total number of nodes for all levels but the root, and then adds the 
-     * root node and subtracts off the leaf nodes to get the final result.
+     * Count the separator keys in a node that are smaller than key, using
+     * the widest SIMD compares that the CPU supports.
      */
-    static inline size_t required_internal_node_cnt(size_t node_cnt, size_t fanout) {
-        /*
-         * I'm tired of fighting with numerical typing...
-         */
-        double df = fanout;
-        double dnc = node_cnt; 
+    static size_t count_less(const K *keys, const K &key) {
+#if defined(__x86_64__)
+        if constexpr (simd_search && (FANOUT * sizeof(K)) % 64 == 0) {
+            static const bool avx512 = __builtin_cpu_supports("avx512f");
+            if (avx512) {
+                return count_less_avx512(keys, FANOUT, key);
+            }
+        }
 
-        size_t inode_cnt = ceil(dnc * (1.0 - pow(1.0/df, log(dnc)/log(df))) / (1.0 - 1.0/df)) - (dnc - 1);
+        if constexpr (simd_search && (FANOUT * sizeof(K)) % 32 == 0) {
+            static const bool avx2 = __builtin_cpu_supports("avx2");
+            if (avx2) {
+                return count_less_avx2(keys, FANOUT, key);
+            }
+        }
+#endif
 
-        /* if inode_cnt > 1, then we'll need to account for the extra root node too */
-        if (inode_cnt > 1) inode_cnt++;
+        size_t cnt = 0;
+        for (size_t i=0; i<FANOUT; i++) {
+            cnt += keys[i] < key;
+        }
 
-        /* 
-         * if inode_cnt == 0, then we'll add one to it. This is a special case 
-         * that could probably be avoided 
-         */
-        if (inode_cnt == 0) inode_cnt++;
+        return cnt;
+    }
+
+    /*
+     * Allocate bytes of memory for part of the internal levels, from the
+     * arena if there is one, and otherwise from the heap.
+     */
+    byte *index_alloc(size_t bytes) {
+        if (m_arena) {
+            byte *ptr = m_arena + m_arena_used;
+            m_arena_used += CACHELINEALIGN(bytes);
+            return ptr;
+        }
+
+        return psudb::sf_aligned_alloc(psudb::CACHELINE_SIZE, bytes);
+    }
+
+    /*
+     * Returns the number of bytes needed by the internal levels of a tree
+     * of record_cnt records, when allocated with index_alloc.
+     */
+    static size_t index_bytes(size_t record_cnt) {
+        if constexpr (LAYOUT == ISAMLayout::EXPLICIT) {
+            size_t lnode_cnt = psudb::TYPEALIGN(leaf_sz, record_cnt * sizeof(R)) / leaf_sz;
+            return CACHELINEALIGN(required_internal_node_cnt(lnode_cnt, FANOUT) * sizeof(inode));
+        } else {
+            auto level_cnts = implicit_level_cnts(record_cnt);
+
+            size_t inode_cnt = 0;
+            for (size_t cnt : level_cnts) {
+                inode_cnt += cnt;
+            }
+
+            size_t bytes = CACHELINEALIGN(inode_cnt * FANOUT * sizeof(K));
+            if constexpr (LAYOUT == ISAMLayout::EYTZINGER) {
+                bytes += CACHELINEALIGN((eytzinger_size(level_cnts[0]) + 1) * sizeof(K));
+            }
+
+            return bytes;
+        }
+    }
+
+    /*
+     * Returns the number of nodes in each level of the IMPLICIT and
+     * EYTZINGER layouts, from the bottom up. In the EYTZINGER layout, only
+     * the lowest level is stored as nodes.
+     */
+    static std::vector<size_t> implicit_level_cnts(size_t record_cnt) {
+        std::vector<size_t> level_cnts;
+        size_t cnt = (record_cnt + FANOUT - 1) / FANOUT;
+        do {
+            cnt = (cnt + FANOUT - 1) / FANOUT;
+            level_cnts.push_back(cnt);
+        } while (cnt > 1 && LAYOUT == ISAMLayout::IMPLICIT);
+
+        return level_cnts;
+    }
+
+    /*
+     * Returns the size of the smallest perfect binary tree with at least
+     * cnt entries.
+     */
+    static size_t eytzinger_size(size_t cnt) {
+        size_t size = 1;
+        while (size < cnt) {
+            size = 2 * size + 1;
+        }
+
+        return size;
+    }
+
+    /*
+     * Determines the number of internal nodes required to build an ISAM Tree
+     * with specified fanout over a given number of leaf nodes, by summing the
+     * number of nodes in each level, up to and including the root.
+     */
+    static inline size_t required_internal_node_cnt(size_t node_cnt, size_t fanout) {
+        size_t inode_cnt = 0;
+        do {
+            node_cnt = (node_cnt + fanout - 1) / fanout;
+            inode_cnt += node_cnt;
+        } while (node_cnt > 1);
 
         return inode_cnt;
     }
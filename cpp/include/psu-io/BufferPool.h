@@ -0,0 +1,290 @@
+/*
+ * include/psu-io/BufferPool.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * A fixed-size pool of page frames caching the contents of one or more
+ * PagedFiles. Pages are identified by the (file, PageNum) pair, and must be
+ * pinned while in use. Modified frames are written back to their file when
+ * they are evicted, or when explicitly flushed. The choice of frame to
+ * evict is delegated to an EvictionPolicy (see psu-io/EvictionPolicy.h).
+ *
+ * The pool is not thread-safe.
+ */
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+
+#include "psu-util/alignment.h"
+#include "psu-util/hash.h"
+#include "psu-io/IOTypes.h"
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+#include "psu-io/EvictionPolicy.h"
+
+namespace psudb {
+
+template <EvictionPolicy POLICY=ClockPolicy>
+class BufferPool {
+public:
+    /*
+     * Create a new pool containing frame_cnt frames, each page_size bytes
+     * long and SECTOR_SIZE aligned, so that they may be used directly for
+     * IO against files opened with O_DIRECT. Only files with a matching
+     * page size may be cached in the pool.
+     */
+    BufferPool(size_t frame_cnt, size_t page_size=PAGE_SIZE)
+      : m_frame_cnt(frame_cnt)
+      , m_page_size(page_size)
+      , m_frames(sf_aligned_alloc(SECTOR_SIZE, frame_cnt * page_size))
+      , m_meta(frame_cnt)
+      , m_policy(frame_cnt) {
+        assert(frame_cnt > 0 && frame_cnt <= (size_t) MAX_FRID);
+        assert(is_valid_page_size(page_size));
+
+        m_free_frames.reserve(frame_cnt);
+        for (size_t i=frame_cnt; i>0; i--) {
+            m_free_frames.push_back(i - 1);
+        }
+    }
+
+    /*
+     * Dirty frames are not written back when the pool is destroyed, as
+     * the files they belong to may already have been closed. Call
+     * flush_all first if their contents must be retained.
+     */
+    ~BufferPool() {
+        free(m_frames);
+    }
+
+    /*
+     * Pin the specified page of pfile into a frame, reading it from the file
+     * if it is not already resident, and return the frame's id. The page will
+     * not be evicted until it has been unpinned as many times as it was
+     * pinned. If read is false and the page is not resident, the frame is
+     * not populated from the file; this is useful for pages which are about
+     * to be completely overwritten.
+     *
+     * Returns INVALID_FRID if every frame is pinned, if an IO error occurs,
+     * or if pfile's page size does not match that of the pool.
+     */
+    FrameId pin(PagedFile *pfile, PageNum pnum, bool read=true) {
+        if (pfile->get_page_size() != m_page_size) {
+            return INVALID_FRID;
+        }
+
+        page_id pid = {pfile, pnum};
+
+        auto itr = m_page_table.find(pid);
+        if (itr != m_page_table.end()) {
+            FrameId frid = itr->second;
+            m_meta[frid].pin_cnt++;
+            m_policy.access(frid);
+            return frid;
+        }
+
+        FrameId frid = get_free_frame();
+        if (frid == INVALID_FRID) {
+            return INVALID_FRID;
+        }
+
+        if (read && !pfile->read_page(pnum, get_frame(frid))) {
+            m_free_frames.push_back(frid);
+            return INVALID_FRID;
+        }
+
+        m_meta[frid] = {pid, 1, false};
+        m_page_table[pid] = frid;
+        m_policy.insert(frid, page_key(pid));
+
+        return frid;
+    }
+
+    /*
+     * Release one pin on the specified frame. If dirty is true, the frame
+     * is marked as modified and will be written back to its file prior to
+     * being evicted.
+     */
+    void unpin(FrameId frid, bool dirty=false) {
+        assert(m_meta[frid].pin_cnt > 0);
+
+        m_meta[frid].pin_cnt--;
+        m_meta[frid].dirty |= dirty;
+    }
+
+    /*
+     * Mark a pinned frame as modified.
+     */
+    void mark_dirty(FrameId frid) {
+        assert(m_meta[frid].pin_cnt > 0);
+        m_meta[frid].dirty = true;
+    }
+
+    /*
+     * Returns a pointer to the page_size byte buffer associated with
+     * a frame. The contents are only valid while the frame is pinned.
+     */
+    byte *get_frame(FrameId frid) {
+        return get_page(m_frames, frid, m_page_size);
+    }
+
+    /*
+     * Write the contents of a frame back to its file, if it is dirty.
+     * Returns 1 on success and 0 on failure.
+     */
+    int flush_frame(FrameId frid) {
+        auto &meta = m_meta[frid];
+        if (!meta.dirty || meta.pid.file == nullptr) {
+            return 1;
+        }
+
+        if (!meta.pid.file->write_page(meta.pid.pnum, get_frame(frid))) {
+            return 0;
+        }
+
+        meta.dirty = false;
+        return 1;
+    }
+
+    /*
+     * Write back all dirty frames associated with pfile. Returns 1 if
+     * all of the writes succeed, and 0 otherwise.
+     */
+    int flush_file(PagedFile *pfile) {
+        int success = 1;
+        for (auto &entry : m_page_table) {
+            if (entry.first.file == pfile) {
+                success &= flush_frame(entry.second);
+            }
+        }
+
+        return success;
+    }
+
+    /*
+     * Write back all dirty frames in the pool. Returns 1 if all of the
+     * writes succeed, and 0 otherwise.
+     */
+    int flush_all() {
+        int success = 1;
+        for (auto &entry : m_page_table) {
+            success &= flush_frame(entry.second);
+        }
+
+        return success;
+    }
+
+    /*
+     * Remove all pages associated with pfile from the pool, without writing
+     * them back. This should be called before a file that has pages in the
+     * pool is closed or removed. None of the file's pages may be pinned.
+     */
+    void discard_file(PagedFile *pfile) {
+        for (auto itr = m_page_table.begin(); itr != m_page_table.end(); ) {
+            if (itr->first.file != pfile) {
+                itr++;
+                continue;
+            }
+
+            FrameId frid = itr->second;
+            assert(m_meta[frid].pin_cnt == 0);
+
+            m_policy.remove(frid);
+            m_meta[frid] = {{nullptr, INVALID_PNUM}, 0, false};
+            m_free_frames.push_back(frid);
+
+            itr = m_page_table.erase(itr);
+        }
+    }
+
+    /*
+     * Returns true if the specified page is currently resident within
+     * the pool.
+     */
+    bool is_resident(PagedFile *pfile, PageNum pnum) const {
+        return m_page_table.contains({pfile, pnum});
+    }
+
+    /*
+     * Returns the total number of frames in the pool.
+     */
+    size_t frame_count() const {
+        return m_frame_cnt;
+    }
+
+    /*
+     * Returns the size, in bytes, of each frame in the pool.
+     */
+    size_t page_size() const {
+        return m_page_size;
+    }
+
+private:
+    struct page_id {
+        PagedFile *file;
+        PageNum pnum;
+
+        bool operator==(const page_id &other) const = default;
+    };
+
+    struct page_id_hash {
+        size_t operator()(const page_id &pid) const {
+            return page_key(pid);
+        }
+    };
+
+    struct frame_meta {
+        page_id pid;
+        size_t pin_cnt;
+        bool dirty;
+    };
+
+    size_t m_frame_cnt;
+    size_t m_page_size;
+    byte *m_frames;
+    std::vector<frame_meta> m_meta;
+    std::vector<FrameId> m_free_frames;
+    std::unordered_map<page_id, FrameId, page_id_hash> m_page_table;
+    POLICY m_policy;
+
+    static uint64_t page_key(const page_id &pid) {
+        return hash((uint64_t) pid.file ^ hash(pid.pnum, kHashMagicNum2));
+    }
+
+    /*
+     * Obtain an empty frame, evicting a page if necessary. Returns
+     * INVALID_FRID if no frame could be freed.
+     */
+    FrameId get_free_frame() {
+        if (m_free_frames.size() > 0) {
+            FrameId frid = m_free_frames.back();
+            m_free_frames.pop_back();
+            return frid;
+        }
+
+        FrameId frid = m_policy.victim([this](FrameId f) { return m_meta[f].pin_cnt == 0; });
+        if (frid == INVALID_FRID) {
+            return INVALID_FRID;
+        }
+
+        /*
+         * If the victim cannot be written back, it must stay resident, so
+         * return it to the policy's control.
+         */
+        if (!flush_frame(frid)) {
+            m_policy.insert(frid, page_key(m_meta[frid].pid));
+            return INVALID_FRID;
+        }
+
+        m_page_table.erase(m_meta[frid].pid);
+        m_meta[frid] = {{nullptr, INVALID_PNUM}, 0, false};
+
+        return frid;
+    }
+};
+
+}
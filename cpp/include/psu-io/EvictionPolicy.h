@@ -0,0 +1,334 @@
+/*
+ * include/psu-io/EvictionPolicy.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * Page replacement policies for use with BufferPool. A policy tracks the
+ * frames that currently hold a page, and selects a frame for eviction
+ * when the pool is full. Policies are only responsible for replacement
+ * decisions--pinning, dirty tracking, and IO are handled by the pool.
+ *
+ * For more information on the policies implemented here, see,
+ *
+ * [1] E. J. O'Neil, P. E. O'Neil, and G. Weikum. The LRU-K page replacement
+ *     algorithm for database disk buffering. SIGMOD 1993.
+ *
+ * [2] T. Johnson and D. Shasha. 2Q: A low overhead high performance buffer
+ *     management replacement algorithm. VLDB 1994.
+ */
+#pragma once
+
+#include <vector>
+#include <list>
+#include <array>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <concepts>
+#include <cstdint>
+
+#include "psu-io/IOTypes.h"
+
+namespace psudb {
+
+/*
+ * The interface required of a replacement policy. The policy is constructed
+ * with the number of frames in the pool, and is informed whenever a page is
+ * loaded into a frame (insert), a resident page is requested (access), or a
+ * frame is explicitly emptied by the pool (remove).
+ *
+ * victim is called when the pool requires a frame and none are free. It must
+ * return a frame for which evictable(frid) is true, or INVALID_FRID if there
+ * are none. The returned frame is considered to be removed from the policy--it
+ * will not be passed to remove, and will be passed to insert once it has
+ * been reused.
+ *
+ * The key passed to insert identifies the page being loaded, and may be used
+ * by policies that retain history for non-resident pages. It is a 64-bit
+ * hash of the page's identity, so two distinct pages may (very rarely)
+ * share a key.
+ */
+template <typename P>
+concept EvictionPolicy = requires(P p, FrameId frid, uint64_t key, bool (*evictable)(FrameId)) {
+    requires std::constructible_from<P, size_t>;
+    {p.insert(frid, key)};
+    {p.access(frid)};
+    {p.remove(frid)};
+    {p.victim(evictable)} -> std::same_as<FrameId>;
+};
+
+
+/*
+ * The CLOCK (second chance) approximation of LRU. Each frame has a
+ * reference bit that is set on access; the clock hand sweeps the frames,
+ * clearing set bits, and evicts the first frame whose bit is already clear.
+ */
+class ClockPolicy {
+public:
+    ClockPolicy(size_t frame_cnt) : m_ref(frame_cnt, 0), m_resident(frame_cnt, 0), m_hand(0) {}
+
+    void insert(FrameId frid, [[maybe_unused]] uint64_t key) {
+        m_resident[frid] = 1;
+        m_ref[frid] = 1;
+    }
+
+    void access(FrameId frid) {
+        m_ref[frid] = 1;
+    }
+
+    void remove(FrameId frid) {
+        m_resident[frid] = 0;
+        m_ref[frid] = 0;
+    }
+
+    template <typename F>
+    FrameId victim(F evictable) {
+        size_t frame_cnt = m_ref.size();
+
+        /*
+         * Two full sweeps is sufficient to find a victim if one exists,
+         * as the first sweep will clear every reference bit.
+         */
+        for (size_t i=0; i<2*frame_cnt; i++) {
+            FrameId frid = m_hand;
+            m_hand = (m_hand + 1 == frame_cnt) ? 0 : m_hand + 1;
+
+            if (!m_resident[frid] || !evictable(frid)) {
+                continue;
+            }
+
+            if (m_ref[frid]) {
+                m_ref[frid] = 0;
+                continue;
+            }
+
+            m_resident[frid] = 0;
+            return frid;
+        }
+
+        return INVALID_FRID;
+    }
+
+private:
+    std::vector<uint8_t> m_ref;
+    std::vector<uint8_t> m_resident;
+    size_t m_hand;
+};
+
+
+/*
+ * The LRU-K policy, which evicts the frame whose K'th most recent access
+ * lies furthest in the past. Frames with fewer than K recorded accesses
+ * are treated as having an infinite backward K-distance, and are evicted
+ * first (in LRU order). History is only retained for resident pages.
+ *
+ * Victim selection is a linear scan over the frames, which is acceptable
+ * for the pool sizes this is intended for.
+ */
+template <size_t K=2>
+class LRUKPolicy {
+    static_assert(K > 0, "LRU-K requires K > 0");
+
+public:
+    LRUKPolicy(size_t frame_cnt) : m_history(frame_cnt), m_resident(frame_cnt, 0), m_clock(0) {}
+
+    void insert(FrameId frid, [[maybe_unused]] uint64_t key) {
+        m_resident[frid] = 1;
+        m_history[frid].fill(0);
+        m_history[frid][0] = ++m_clock;
+    }
+
+    void access(FrameId frid) {
+        auto &hist = m_history[frid];
+        for (size_t i=K-1; i>0; i--) {
+            hist[i] = hist[i-1];
+        }
+
+        hist[0] = ++m_clock;
+    }
+
+    void remove(FrameId frid) {
+        m_resident[frid] = 0;
+    }
+
+    template <typename F>
+    FrameId victim(F evictable) {
+        FrameId best = INVALID_FRID;
+
+        for (size_t i=0; i<m_history.size(); i++) {
+            if (!m_resident[i] || !evictable(i)) {
+                continue;
+            }
+
+            if (best == INVALID_FRID || precedes(m_history[i], m_history[best])) {
+                best = i;
+            }
+        }
+
+        if (best != INVALID_FRID) {
+            m_resident[best] = 0;
+        }
+
+        return best;
+    }
+
+private:
+    std::vector<std::array<uint64_t, K>> m_history;
+    std::vector<uint8_t> m_resident;
+    uint64_t m_clock;
+
+    /*
+     * Returns true if a frame with history a should be evicted before
+     * one with history b. A zero timestamp indicates a missing access,
+     * and so sorts as infinitely far in the past.
+     */
+    static bool precedes(const std::array<uint64_t, K> &a, const std::array<uint64_t, K> &b) {
+        if (a[K-1] != b[K-1]) {
+            return a[K-1] < b[K-1];
+        }
+
+        return a[0] < b[0];
+    }
+};
+
+
+/*
+ * The full version of the 2Q policy. Newly loaded pages enter a FIFO
+ * queue (A1in). Pages evicted from A1in are remembered in a ghost queue
+ * (A1out), and if they are requested again while remembered, they are
+ * promoted into an LRU queue (Am). This keeps pages that are touched once,
+ * such as those read during a scan, from flushing the hot set out of the
+ * pool.
+ *
+ * The sizes of A1in and A1out are expressed as fractions of the number
+ * of frames, using the values recommended in [2].
+ *
+ * A1out remembers only the keys of pages, not their identities, so pages
+ * whose keys collide share a single ghost entry. This is an accepted
+ * approximation: a collision can only cause a page to be promoted into Am
+ * when it should not be (or vice versa), which affects the hit rate but
+ * never correctness, and is vanishingly unlikely with 64-bit keys.
+ */
+class TwoQPolicy {
+    enum queue_id : uint8_t {
+        Q_NONE,
+        Q_A1IN,
+        Q_AM
+    };
+
+public:
+    TwoQPolicy(size_t frame_cnt)
+      : m_kin(std::max<size_t>(frame_cnt / 4, 1)), m_kout(std::max<size_t>(frame_cnt / 2, 1))
+      , m_queue(frame_cnt, Q_NONE), m_pos(frame_cnt), m_keys(frame_cnt, 0) {}
+
+    void insert(FrameId frid, uint64_t key) {
+        m_keys[frid] = key;
+
+        auto ghost = m_a1out_idx.find(key);
+        if (ghost != m_a1out_idx.end()) {
+            m_a1out.erase(ghost->second);
+            m_a1out_idx.erase(ghost);
+
+            m_am.push_back(frid);
+            m_pos[frid] = std::prev(m_am.end());
+            m_queue[frid] = Q_AM;
+            return;
+        }
+
+        m_a1in.push_back(frid);
+        m_pos[frid] = std::prev(m_a1in.end());
+        m_queue[frid] = Q_A1IN;
+    }
+
+    void access(FrameId frid) {
+        /* accesses to pages within A1in are deliberately ignored */
+        if (m_queue[frid] == Q_AM) {
+            m_am.splice(m_am.end(), m_am, m_pos[frid]);
+        }
+    }
+
+    void remove(FrameId frid) {
+        unlink(frid);
+    }
+
+    template <typename F>
+    FrameId victim(F evictable) {
+        FrameId frid = INVALID_FRID;
+
+        if (m_a1in.size() > m_kin || m_am.empty()) {
+            frid = first_evictable(m_a1in, evictable);
+            if (frid == INVALID_FRID) {
+                frid = first_evictable(m_am, evictable);
+            }
+        } else {
+            frid = first_evictable(m_am, evictable);
+            if (frid == INVALID_FRID) {
+                frid = first_evictable(m_a1in, evictable);
+            }
+        }
+
+        if (frid == INVALID_FRID) {
+            return INVALID_FRID;
+        }
+
+        /* pages evicted from A1in are remembered in the ghost queue */
+        if (m_queue[frid] == Q_A1IN) {
+            remember(m_keys[frid]);
+        }
+
+        unlink(frid);
+        return frid;
+    }
+
+private:
+    size_t m_kin;
+    size_t m_kout;
+
+    std::list<FrameId> m_a1in;
+    std::list<FrameId> m_am;
+    std::list<uint64_t> m_a1out;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> m_a1out_idx;
+
+    std::vector<queue_id> m_queue;
+    std::vector<std::list<FrameId>::iterator> m_pos;
+    std::vector<uint64_t> m_keys;
+
+    template <typename F>
+    static FrameId first_evictable(const std::list<FrameId> &queue, F &evictable) {
+        for (FrameId frid : queue) {
+            if (evictable(frid)) {
+                return frid;
+            }
+        }
+
+        return INVALID_FRID;
+    }
+
+    void unlink(FrameId frid) {
+        if (m_queue[frid] == Q_A1IN) {
+            m_a1in.erase(m_pos[frid]);
+        } else if (m_queue[frid] == Q_AM) {
+            m_am.erase(m_pos[frid]);
+        }
+
+        m_queue[frid] = Q_NONE;
+    }
+
+    void remember(uint64_t key) {
+        if (m_a1out_idx.contains(key)) {
+            return;
+        }
+
+        m_a1out.push_back(key);
+        m_a1out_idx[key] = std::prev(m_a1out.end());
+
+        if (m_a1out.size() > m_kout) {
+            m_a1out_idx.erase(m_a1out.front());
+            m_a1out.pop_front();
+        }
+    }
+};
+
+}
@@ -0,0 +1,334 @@
+/*
+ * include/psu-io/FreeSpaceMap.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * Free-space management for a PagedFile. Pages that are no longer needed
+ * can be returned to the map, which records them in a bitmap and hands
+ * them out again, as contiguous extents, on subsequent allocations. Only
+ * when no suitable extent is free is the file itself grown. Freed pages
+ * can also have their storage released to the filesystem, so that the
+ * on-disk footprint of a file tracks its live data.
+ *
+ * The bitmap is persisted within the file, in a chain of pages starting
+ * at a root page. The root's PageNum should be recorded by the caller
+ * (e.g., in its own header page) so that the map can be reopened. The map
+ * is not written back automatically; call flush to persist it. Pages
+ * should only be reused after a flush recording them as free has
+ * completed if the map must remain consistent with the file across a
+ * crash.
+ *
+ * The map is not thread-safe.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "psu-util/alignment.h"
+#include "psu-ds/BitArray.h"
+#include "psu-io/IOTypes.h"
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+
+namespace psudb {
+
+class FreeSpaceMap {
+public:
+    /*
+     * Create a new, empty map for pfile, allocating its root page from the
+     * end of the file. Returns nullptr if the root page cannot be allocated
+     * or written.
+     */
+    static std::unique_ptr<FreeSpaceMap> create(PagedFile *pfile) {
+        PageNum root = pfile->allocate_pages(1);
+        if (root == INVALID_PNUM) {
+            return nullptr;
+        }
+
+        auto map = std::unique_ptr<FreeSpaceMap>(new FreeSpaceMap(pfile));
+        map->m_chunks.push_back({BitArray(map->m_bits_per_chunk), root, true});
+
+        if (!map->flush()) {
+            return nullptr;
+        }
+
+        return map;
+    }
+
+    /*
+     * Load an existing map from pfile, starting at the specified root page.
+     * Returns nullptr if the map cannot be read, or if root does not refer
+     * to a map.
+     */
+    static std::unique_ptr<FreeSpaceMap> open(PagedFile *pfile, PageNum root) {
+        auto map = std::unique_ptr<FreeSpaceMap>(new FreeSpaceMap(pfile));
+
+        PageNum pnum = root;
+        while (pnum != INVALID_PNUM) {
+            if (!pfile->read_page(pnum, map->m_buffer)) {
+                return nullptr;
+            }
+
+            auto header = (const map_header *) map->m_buffer;
+            if (header->magic != MAP_MAGIC) {
+                return nullptr;
+            }
+
+            chunk c = {BitArray(map->m_bits_per_chunk), pnum, false};
+            memcpy(c.bits.data(), map->m_buffer + sizeof(map_header), map->m_bits_per_chunk / 8);
+            map->m_chunks.push_back(std::move(c));
+
+            pnum = header->next;
+        }
+
+        for (size_t i=0; i<map->m_chunks.size(); i++) {
+            for (size_t j=0; j<map->m_bits_per_chunk; j++) {
+                map->m_free_cnt += map->m_chunks[i].bits.is_set(j);
+            }
+        }
+
+        return map;
+    }
+
+    ~FreeSpaceMap() {
+        free(m_buffer);
+    }
+
+    /*
+     * Allocate count contiguous pages, and return the PageNum of the first.
+     * The lowest free extent of sufficient length is used if one exists;
+     * otherwise the file is grown. The contents of reused pages are
+     * undefined. Returns INVALID_PNUM on failure.
+     */
+    PageNum allocate(PageNum count=1) {
+        if (count == 0) {
+            return INVALID_PNUM;
+        }
+
+        if (m_free_cnt >= count) {
+            PageNum first = find_extent(count);
+            if (first != INVALID_PNUM) {
+                for (PageNum p=first; p<first + count; p++) {
+                    set_free(p, false);
+                }
+
+                m_free_cnt -= count;
+                return first;
+            }
+        }
+
+        return m_pfile->allocate_pages(count);
+    }
+
+    /*
+     * Return count contiguous pages, starting at first, to the map. If
+     * discard is true, their storage is also released to the filesystem.
+     * Returns 1 on success. Returns 0, without changing the map, if any of
+     * the pages is invalid, is already free, or holds the map itself.
+     */
+    int release(PageNum first, PageNum count=1, bool discard=true) {
+        if (count == 0 || first == INVALID_PNUM || (size_t) first + count - 1 > m_pfile->get_page_count()) {
+            return 0;
+        }
+
+        for (PageNum p=first; p<first + count; p++) {
+            if (is_free(p) || is_map_page(p)) {
+                return 0;
+            }
+        }
+
+        /* extend the map to cover the released pages, if necessary */
+        while ((size_t) (first + count - 1) / m_bits_per_chunk >= m_chunks.size()) {
+            if (!add_chunk()) {
+                return 0;
+            }
+        }
+
+        for (PageNum p=first; p<first + count; p++) {
+            set_free(p, true);
+        }
+
+        m_free_cnt += count;
+        m_search_hint = std::min(m_search_hint, first);
+
+        if (discard) {
+            m_pfile->discard_pages(first, count);
+        }
+
+        return 1;
+    }
+
+    /*
+     * Returns true if the specified page is free.
+     */
+    bool is_free(PageNum pnum) const {
+        size_t idx = pnum / m_bits_per_chunk;
+        return idx < m_chunks.size() && m_chunks[idx].bits.is_set(pnum % m_bits_per_chunk);
+    }
+
+    /*
+     * Returns the number of free pages.
+     */
+    size_t free_count() const {
+        return m_free_cnt;
+    }
+
+    /*
+     * Returns the first page of the map, which is needed to reopen it.
+     */
+    PageNum get_root() const {
+        return m_chunks[0].pnum;
+    }
+
+    /*
+     * Write any modified portions of the map back to the file. Returns 1
+     * on success and 0 on failure.
+     */
+    int flush() {
+        for (size_t i=0; i<m_chunks.size(); i++) {
+            if (!m_chunks[i].dirty) {
+                continue;
+            }
+
+            map_header header = {MAP_MAGIC, (i + 1 < m_chunks.size()) ? m_chunks[i+1].pnum : INVALID_PNUM, 0};
+            memcpy(m_buffer, &header, sizeof(header));
+            memcpy(m_buffer + sizeof(header), m_chunks[i].bits.data(), m_bits_per_chunk / 8);
+
+            if (!m_pfile->write_page(m_chunks[i].pnum, m_buffer)) {
+                return 0;
+            }
+
+            m_chunks[i].dirty = false;
+        }
+
+        return 1;
+    }
+
+private:
+    static const uint32_t MAP_MAGIC = 0x5053464d;
+
+    struct map_header {
+        uint32_t magic;
+        PageNum next;
+        uint64_t reserved;
+    };
+
+    /*
+     * The portion of the bitmap stored within a single page. A set bit
+     * indicates a free page.
+     */
+    struct chunk {
+        BitArray bits;
+        PageNum pnum;
+        bool dirty;
+    };
+
+    PagedFile *m_pfile;
+    size_t m_bits_per_chunk;
+    std::vector<chunk> m_chunks;
+    size_t m_free_cnt;
+    PageNum m_search_hint;
+    byte *m_buffer;
+
+    FreeSpaceMap(PagedFile *pfile)
+      : m_pfile(pfile)
+      , m_bits_per_chunk((pfile->get_payload_size() - sizeof(map_header)) * 8)
+      , m_free_cnt(0)
+      , m_search_hint(1)
+      , m_buffer(sf_aligned_alloc(SECTOR_SIZE, pfile->get_page_size())) {}
+
+    void set_free(PageNum pnum, bool free) {
+        auto &c = m_chunks[pnum / m_bits_per_chunk];
+        if (free) {
+            c.bits.set(pnum % m_bits_per_chunk);
+        } else {
+            c.bits.unset(pnum % m_bits_per_chunk);
+        }
+
+        c.dirty = true;
+    }
+
+    bool is_map_page(PageNum pnum) const {
+        for (auto &c : m_chunks) {
+            if (c.pnum == pnum) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool add_chunk() {
+        PageNum pnum = m_pfile->allocate_pages(1);
+        if (pnum == INVALID_PNUM) {
+            return false;
+        }
+
+        /* the previous chunk must be rewritten to link to the new one */
+        m_chunks.back().dirty = true;
+        m_chunks.push_back({BitArray(m_bits_per_chunk), pnum, true});
+
+        return true;
+    }
+
+    /*
+     * Find the lowest run of count free pages, skipping over fully
+     * allocated 64-page words of the bitmap. Returns INVALID_PNUM if
+     * there is no such run.
+     */
+    PageNum find_extent(PageNum count) {
+        size_t total = m_chunks.size() * m_bits_per_chunk;
+        size_t run_start = 0;
+        size_t run_len = 0;
+        bool first_free_seen = false;
+
+        for (size_t p=m_search_hint; p<total; ) {
+            size_t bit = p % m_bits_per_chunk;
+            auto &bits = m_chunks[p / m_bits_per_chunk].bits;
+
+            if (bit % 64 == 0 && bit + 64 <= m_bits_per_chunk) {
+                uint64_t word;
+                memcpy(&word, bits.data() + bit / 8, sizeof(word));
+                if (word == 0) {
+                    run_len = 0;
+                    p += 64;
+                    continue;
+                }
+            }
+
+            if (!bits.is_set(bit)) {
+                run_len = 0;
+                p++;
+                continue;
+            }
+
+            if (!first_free_seen) {
+                /* no free pages exist below this one */
+                m_search_hint = p;
+                first_free_seen = true;
+            }
+
+            if (run_len++ == 0) {
+                run_start = p;
+            }
+
+            if (run_len == count) {
+                if (run_start == m_search_hint) {
+                    m_search_hint = run_start + count;
+                }
+
+                return run_start;
+            }
+
+            p++;
+        }
+
+        return INVALID_PNUM;
+    }
+};
+
+}
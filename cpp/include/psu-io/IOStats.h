@@ -0,0 +1,314 @@
+/*
+ * include/psu-io/IOStats.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * Runtime IO statistics. Each PagedFile owns an IOStats object recording the
+ * number of operations, pages, bytes, and system calls issued for each type
+ * of IO, along with a histogram of operation latencies. All counters are
+ * updated using relaxed atomics, and each operation type is kept on its own
+ * cache line, so recording is cheap enough to leave enabled.
+ *
+ * Every IOStats object is registered with the global IOStatsRegistry, which
+ * can produce totals across all files, including those that have since
+ * been closed.
+ */
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "psu-util/alignment.h"
+
+namespace psudb {
+
+/*
+ * The types of operation for which statistics are recorded.
+ */
+enum IOOpType {
+    IO_OP_READ = 0,
+    IO_OP_WRITE = 1,
+    IO_OP_CNT = 2
+};
+
+/*
+ * The number of buckets in the latency histograms. Bucket i counts the
+ * operations taking between 2^i and 2^(i+1) - 1 nanoseconds, with the
+ * final bucket also counting everything longer than that.
+ */
+const size_t IO_LATENCY_BUCKETS = 40;
+
+/*
+ * A point-in-time copy of the statistics for a single operation type.
+ */
+struct IOOpSnapshot {
+    uint64_t ops = 0;
+    uint64_t pages = 0;
+    uint64_t bytes = 0;
+    uint64_t syscalls = 0;
+    uint64_t total_ns = 0;
+    std::array<uint64_t, IO_LATENCY_BUCKETS> latency_hist = {};
+
+    IOOpSnapshot &operator+=(const IOOpSnapshot &other) {
+        ops += other.ops;
+        pages += other.pages;
+        bytes += other.bytes;
+        syscalls += other.syscalls;
+        total_ns += other.total_ns;
+        for (size_t i=0; i<IO_LATENCY_BUCKETS; i++) {
+            latency_hist[i] += other.latency_hist[i];
+        }
+
+        return *this;
+    }
+
+    /*
+     * Returns the mean latency of the recorded operations, in nanoseconds.
+     */
+    double mean_latency() const {
+        return (ops) ? (double) total_ns / (double) ops : 0;
+    }
+
+    /*
+     * Returns an upper bound on the latency, in nanoseconds, below which
+     * the fraction p of the recorded operations fall. The result has the
+     * resolution of the histogram buckets.
+     */
+    uint64_t latency_percentile(double p) const {
+        uint64_t total = 0;
+        for (auto cnt : latency_hist) total += cnt;
+
+        if (total == 0) {
+            return 0;
+        }
+
+        uint64_t target = std::max<uint64_t>(1, p * total);
+        uint64_t seen = 0;
+        for (size_t i=0; i<IO_LATENCY_BUCKETS; i++) {
+            seen += latency_hist[i];
+            if (seen >= target) {
+                return (2ull << i) - 1;
+            }
+        }
+
+        return UINT64_MAX;
+    }
+};
+
+/*
+ * A point-in-time copy of an IOStats object.
+ */
+struct IOStatsSnapshot {
+    std::array<IOOpSnapshot, IO_OP_CNT> op;
+    uint64_t async_submits = 0;
+    uint64_t checksum_failures = 0;
+
+    const IOOpSnapshot &reads() const { return op[IO_OP_READ]; }
+    const IOOpSnapshot &writes() const { return op[IO_OP_WRITE]; }
+
+    IOStatsSnapshot &operator+=(const IOStatsSnapshot &other) {
+        for (size_t i=0; i<IO_OP_CNT; i++) {
+            op[i] += other.op[i];
+        }
+
+        async_submits += other.async_submits;
+        checksum_failures += other.checksum_failures;
+        return *this;
+    }
+};
+
+
+class IOStats;
+
+/*
+ * A global registry of every live IOStats object, used to aggregate
+ * statistics across files. When an IOStats object is destroyed, its
+ * final values are folded into the registry so that they are retained.
+ */
+class IOStatsRegistry {
+public:
+    static IOStatsRegistry &get() {
+        static IOStatsRegistry registry;
+        return registry;
+    }
+
+    /*
+     * Returns the sum of the statistics of every file that has been
+     * opened since the last call to reset.
+     */
+    IOStatsSnapshot aggregate();
+
+    /*
+     * Zero the statistics of every live file, and discard those
+     * retained from closed files.
+     */
+    void reset();
+
+private:
+    std::mutex m_mutex;
+    std::vector<IOStats *> m_live;
+    IOStatsSnapshot m_retired;
+
+    friend class IOStats;
+
+    IOStatsRegistry() = default;
+
+    void add(IOStats *stats) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_live.push_back(stats);
+    }
+
+    void remove(IOStats *stats, const IOStatsSnapshot &final) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_live.erase(std::remove(m_live.begin(), m_live.end(), stats), m_live.end());
+        m_retired += final;
+    }
+};
+
+
+class IOStats {
+    typedef std::chrono::steady_clock clock;
+
+public:
+    typedef clock::time_point time_point;
+
+    /*
+     * Create a new statistics object, counting pages of page_size bytes.
+     */
+    IOStats(size_t page_size=PAGE_SIZE) : m_page_size(page_size) {
+        IOStatsRegistry::get().add(this);
+    }
+
+    IOStats(const IOStats &) = delete;
+    IOStats &operator=(const IOStats &) = delete;
+
+    ~IOStats() {
+        IOStatsRegistry::get().remove(this, snapshot());
+    }
+
+    /*
+     * Returns the current time, for use as the start time of a recorded
+     * operation.
+     */
+    static time_point now() {
+        return clock::now();
+    }
+
+    /*
+     * Record the completion of an operation of type t that began at start,
+     * and which transferred the specified number of bytes using syscalls
+     * system calls.
+     */
+    void record(IOOpType t, uint64_t bytes, uint64_t syscalls, time_point start) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        auto &c = m_ops[t];
+
+        c.ops.fetch_add(1, std::memory_order_relaxed);
+        c.pages.fetch_add(bytes / m_page_size, std::memory_order_relaxed);
+        c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        c.syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+        c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        c.latency_hist[latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Record a submission of queued asynchronous requests to the kernel.
+     */
+    void record_async_submit() {
+        m_async_submits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Record a page which failed checksum verification when read.
+     */
+    void record_checksum_failure() {
+        m_checksum_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    IOStatsSnapshot snapshot() const {
+        IOStatsSnapshot snap;
+        for (size_t i=0; i<IO_OP_CNT; i++) {
+            auto &c = m_ops[i];
+            auto &s = snap.op[i];
+
+            s.ops = c.ops.load(std::memory_order_relaxed);
+            s.pages = c.pages.load(std::memory_order_relaxed);
+            s.bytes = c.bytes.load(std::memory_order_relaxed);
+            s.syscalls = c.syscalls.load(std::memory_order_relaxed);
+            s.total_ns = c.total_ns.load(std::memory_order_relaxed);
+            for (size_t j=0; j<IO_LATENCY_BUCKETS; j++) {
+                s.latency_hist[j] = c.latency_hist[j].load(std::memory_order_relaxed);
+            }
+        }
+
+        snap.async_submits = m_async_submits.load(std::memory_order_relaxed);
+        snap.checksum_failures = m_checksum_failures.load(std::memory_order_relaxed);
+        return snap;
+    }
+
+    void reset() {
+        for (auto &c : m_ops) {
+            c.ops.store(0, std::memory_order_relaxed);
+            c.pages.store(0, std::memory_order_relaxed);
+            c.bytes.store(0, std::memory_order_relaxed);
+            c.syscalls.store(0, std::memory_order_relaxed);
+            c.total_ns.store(0, std::memory_order_relaxed);
+            for (auto &b : c.latency_hist) {
+                b.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        m_async_submits.store(0, std::memory_order_relaxed);
+        m_checksum_failures.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(CACHELINE_SIZE) op_counters {
+        std::atomic<uint64_t> ops{0};
+        std::atomic<uint64_t> pages{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> syscalls{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::array<std::atomic<uint64_t>, IO_LATENCY_BUCKETS> latency_hist{};
+    };
+
+    size_t m_page_size;
+    std::array<op_counters, IO_OP_CNT> m_ops;
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> m_async_submits{0};
+    std::atomic<uint64_t> m_checksum_failures{0};
+
+    static size_t latency_bucket(uint64_t ns) {
+        size_t bucket = (ns == 0) ? 0 : 63 - __builtin_clzll(ns);
+        return std::min(bucket, IO_LATENCY_BUCKETS - 1);
+    }
+};
+
+
+inline IOStatsSnapshot IOStatsRegistry::aggregate() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    IOStatsSnapshot total = m_retired;
+    for (auto stats : m_live) {
+        total += stats->snapshot();
+    }
+
+    return total;
+}
+
+inline void IOStatsRegistry::reset() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_retired = IOStatsSnapshot();
+    for (auto stats : m_live) {
+        stats->reset();
+    }
+}
+
+}
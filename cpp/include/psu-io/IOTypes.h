@@ -1,3 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/types.h>
+
 #include "psu-util/alignment.h"
 
 namespace psudb {
@@ -12,7 +17,7 @@ typedef uint32_t PageNum;
 /*
  * Byte offset within a page. Also used for lengths of records, etc.,
  * within the codebase. size_t isn't necessary, as the maximum offset
- * is only PAGE_SIZE 
+ * is only MAX_PAGE_SIZE - 1
  */
 typedef uint16_t PageOffset;
 
@@ -28,20 +33,46 @@ typedef int32_t FrameId;
 const PageNum INVALID_PNUM = 0;
 const FrameId INVALID_FRID = -1;
 
+/*
+ * The smallest and largest page sizes (in bytes) supported by PagedFile.
+ * Page sizes must also be a power of two.
+ */
+const size_t MIN_PAGE_SIZE = SECTOR_SIZE;
+const size_t MAX_PAGE_SIZE = 65536;
+
 /*
  * Maximum values for the various IO types
  */
 const PageNum MAX_PNUM = UINT32_MAX;
-const PageOffset MAX_POFF = PAGE_SIZE;
+const PageOffset MAX_POFF = MAX_PAGE_SIZE - 1;
 const FrameId MAX_FRID = INT32_MAX;
 
+/*
+ * Access pattern hints for memory-mapped files.
+ */
+enum MapAdvice {
+    ADVISE_NORMAL,
+    ADVISE_SEQUENTIAL,
+    ADVISE_RANDOM,
+    ADVISE_WILLNEED
+};
+
+
+/*
+ * Returns true if page_size is a valid page size for a PagedFile.
+ */
+static inline bool is_valid_page_size(size_t page_size) {
+    return page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE
+        && (page_size & (page_size - 1)) == 0;
+}
+
 
 /*
  * Convert a Page Number to its associated byte offset within 
  * a file or contiguous buffer
  */
-static inline off_t pnum_to_offset(PageNum pnum) {
-    return pnum * PAGE_SIZE;
+static inline off_t pnum_to_offset(PageNum pnum, size_t page_size=PAGE_SIZE) {
+    return (off_t) pnum * page_size;
 }
 
 
@@ -50,8 +81,8 @@ static inline off_t pnum_to_offset(PageNum pnum) {
  * buffer. buffer must be page aligned, and idx must be less than the
  * number of pages within the buffer, or the result is undefined.
  */
-static inline byte *get_page(byte *buffer, size_t idx) {
-    return buffer + (idx * PAGE_SIZE);
+static inline byte *get_page(byte *buffer, size_t idx, size_t page_size=PAGE_SIZE) {
+    return buffer + (idx * page_size);
 }
 
 }
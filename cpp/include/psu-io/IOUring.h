@@ -0,0 +1,301 @@
+/*
+ * include/psu-io/IOUring.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * A minimal wrapper around a Linux io_uring instance, used to provide
+ * asynchronous IO for PagedFile. This talks to the kernel directly via
+ * the io_uring_setup/io_uring_enter system calls, rather than through
+ * liburing, so that psu-io remains header-only with no additional
+ * link-time dependencies.
+ *
+ * The ring is not thread-safe; each instance should be used by only one
+ * thread at a time.
+ */
+#pragma once
+
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+namespace psudb {
+
+/*
+ * A handle to an outstanding asynchronous IO request, used to poll
+ * for (or wait upon) its completion.
+ */
+typedef uint64_t IOToken;
+
+/*
+ * Invalid token value, used to indicate that an asynchronous request
+ * could not be issued.
+ */
+const IOToken INVALID_IOTOKEN = 0;
+
+/*
+ * The possible states of an asynchronous IO request.
+ */
+enum IOStatus {
+    IO_FAILED = 0,
+    IO_SUCCESS = 1,
+    IO_PENDING = 2
+};
+
+class IOUring {
+public:
+    /*
+     * Create a new ring capable of holding depth outstanding submission
+     * queue entries. Returns nullptr if the ring could not be created
+     * (e.g., if io_uring is not supported by the running kernel).
+     */
+    static std::unique_ptr<IOUring> create(unsigned depth=64) {
+        io_uring_params parms;
+        memset(&parms, 0, sizeof(parms));
+
+        int fd = syscall(__NR_io_uring_setup, depth, &parms);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        auto ring = std::unique_ptr<IOUring>(new IOUring(fd));
+        if (!ring->map_rings(parms)) {
+            return nullptr;
+        }
+
+        return ring;
+    }
+
+    /*
+     * Queue a read of len bytes at offset within fd into buffer. The
+     * request is not issued to the kernel until submit() is called.
+     * Returns true if the request was queued, and false if the
+     * submission queue is full.
+     */
+    bool queue_read(int fd, void *buffer, uint32_t len, off_t offset, uint64_t user_data) {
+        return queue(IORING_OP_READ, fd, buffer, len, offset, user_data);
+    }
+
+    /*
+     * Queue a vectored read into the iov_cnt buffers described by iov.
+     * The iovec array must remain valid until the request completes.
+     */
+    bool queue_readv(int fd, const iovec *iov, uint32_t iov_cnt, off_t offset, uint64_t user_data) {
+        return queue(IORING_OP_READV, fd, iov, iov_cnt, offset, user_data);
+    }
+
+    /*
+     * Queue a write of len bytes from buffer to offset within fd.
+     */
+    bool queue_write(int fd, const void *buffer, uint32_t len, off_t offset, uint64_t user_data) {
+        return queue(IORING_OP_WRITE, fd, buffer, len, offset, user_data);
+    }
+
+    /*
+     * Issue all queued requests to the kernel. If wait_cnt is non-zero,
+     * blocks until at least that many completions are available. Returns
+     * the number of requests submitted, or -1 on error.
+     */
+    int submit(unsigned wait_cnt=0) {
+        unsigned to_submit = m_sq_local_tail - m_sq_submitted;
+        unsigned flags = (wait_cnt > 0) ? IORING_ENTER_GETEVENTS : 0;
+
+        if (to_submit == 0 && wait_cnt == 0) {
+            return 0;
+        }
+
+        int res;
+        do {
+            res = syscall(__NR_io_uring_enter, m_fd, to_submit, wait_cnt, flags, nullptr, 0);
+        } while (res < 0 && errno == EINTR);
+
+        if (res < 0) {
+            return -1;
+        }
+
+        m_sq_submitted += res;
+        m_in_flight += res;
+        return res;
+    }
+
+    /*
+     * Retrieve a single completion from the ring, if one is available,
+     * and place its user data and result into the provided locations.
+     * If wait is true, blocks until a completion arrives. Returns true
+     * if a completion was retrieved.
+     */
+    bool reap(uint64_t *user_data, int32_t *result, bool wait=false) {
+        while (true) {
+            unsigned head = *m_cq_head;
+            unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+
+            if (head != tail) {
+                io_uring_cqe *cqe = &m_cqes[head & *m_cq_mask];
+                *user_data = cqe->user_data;
+                *result = cqe->res;
+
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+                m_in_flight--;
+                return true;
+            }
+
+            if (!wait || m_in_flight == 0 || submit(1) < 0) {
+                return false;
+            }
+        }
+    }
+
+    /*
+     * Returns the number of additional requests that can be queued
+     * before the submission queue is full.
+     */
+    unsigned queue_space() const {
+        unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        return m_sq_entries - (m_sq_local_tail - head);
+    }
+
+    /*
+     * Returns the number of requests that have been submitted to the
+     * kernel, but whose completions have not yet been reaped.
+     */
+    size_t in_flight() const {
+        return m_in_flight;
+    }
+
+    /*
+     * Returns the maximum number of requests that may be outstanding
+     * at one time.
+     */
+    unsigned capacity() const {
+        return m_sq_entries;
+    }
+
+    ~IOUring() {
+        if (m_sqes) munmap(m_sqes, m_sqes_sz);
+        if (m_cq_ring && m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_ring_sz);
+        if (m_sq_ring) munmap(m_sq_ring, m_sq_ring_sz);
+        close(m_fd);
+    }
+
+private:
+    int m_fd;
+
+    void *m_sq_ring;
+    void *m_cq_ring;
+    size_t m_sq_ring_sz;
+    size_t m_cq_ring_sz;
+
+    io_uring_sqe *m_sqes;
+    size_t m_sqes_sz;
+
+    unsigned *m_sq_head;
+    unsigned *m_sq_tail;
+    unsigned *m_sq_mask;
+    unsigned *m_sq_array;
+    unsigned m_sq_entries;
+    unsigned m_sq_local_tail;
+    unsigned m_sq_submitted;
+
+    unsigned *m_cq_head;
+    unsigned *m_cq_tail;
+    unsigned *m_cq_mask;
+    io_uring_cqe *m_cqes;
+
+    size_t m_in_flight;
+
+    IOUring(int fd)
+      : m_fd(fd), m_sq_ring(nullptr), m_cq_ring(nullptr), m_sq_ring_sz(0)
+      , m_cq_ring_sz(0), m_sqes(nullptr), m_sqes_sz(0), m_sq_local_tail(0)
+      , m_sq_submitted(0), m_in_flight(0) {}
+
+    bool map_rings(const io_uring_params &parms) {
+        m_sq_ring_sz = parms.sq_off.array + parms.sq_entries * sizeof(unsigned);
+        m_cq_ring_sz = parms.cq_off.cqes + parms.cq_entries * sizeof(io_uring_cqe);
+
+        /*
+         * Newer kernels allow both rings to share a single mapping, in which
+         * case it must be large enough to accommodate either of them.
+         */
+        bool single_mmap = parms.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            m_sq_ring_sz = std::max(m_sq_ring_sz, m_cq_ring_sz);
+            m_cq_ring_sz = m_sq_ring_sz;
+        }
+
+        m_sq_ring = mmap(nullptr, m_sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sq_ring == MAP_FAILED) {
+            m_sq_ring = nullptr;
+            return false;
+        }
+
+        if (single_mmap) {
+            m_cq_ring = m_sq_ring;
+        } else {
+            m_cq_ring = mmap(nullptr, m_cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (m_cq_ring == MAP_FAILED) {
+                m_cq_ring = nullptr;
+                return false;
+            }
+        }
+
+        m_sqes_sz = parms.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = (io_uring_sqe *) mmap(nullptr, m_sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED) {
+            m_sqes = nullptr;
+            return false;
+        }
+
+        char *sq = (char *) m_sq_ring;
+        m_sq_head = (unsigned *) (sq + parms.sq_off.head);
+        m_sq_tail = (unsigned *) (sq + parms.sq_off.tail);
+        m_sq_mask = (unsigned *) (sq + parms.sq_off.ring_mask);
+        m_sq_array = (unsigned *) (sq + parms.sq_off.array);
+        m_sq_entries = parms.sq_entries;
+        m_sq_local_tail = *m_sq_tail;
+        m_sq_submitted = m_sq_local_tail;
+
+        char *cq = (char *) m_cq_ring;
+        m_cq_head = (unsigned *) (cq + parms.cq_off.head);
+        m_cq_tail = (unsigned *) (cq + parms.cq_off.tail);
+        m_cq_mask = (unsigned *) (cq + parms.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe *) (cq + parms.cq_off.cqes);
+
+        return true;
+    }
+
+    bool queue(uint8_t opcode, int fd, const void *addr, uint32_t len, off_t offset, uint64_t user_data) {
+        if (queue_space() == 0) {
+            return false;
+        }
+
+        unsigned idx = m_sq_local_tail & *m_sq_mask;
+        io_uring_sqe *sqe = &m_sqes[idx];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) addr;
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+
+        m_sq_array[idx] = idx;
+        m_sq_local_tail++;
+
+        /* publish the new entry to the kernel */
+        __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+
+        return true;
+    }
+};
+
+}
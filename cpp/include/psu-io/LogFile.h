@@ -0,0 +1,464 @@
+/*
+ * include/psu-io/LogFile.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * An append-only log file with group commit. Records are appended into an
+ * in-memory buffer, and are made durable in batches: a single SECTOR_SIZE
+ * aligned write, followed by a single fdatasync, covers every record that
+ * was appended since the previous commit. When several threads commit at
+ * once, one of them performs the IO on behalf of all of the others.
+ *
+ * Each record is stored with a header containing its length and a CRC-32C
+ * checksum. On opening an existing log, the records are scanned, and the
+ * log is truncated following the last intact record, discarding any
+ * partially written tail left behind by a crash.
+ */
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+
+#include "psu-util/alignment.h"
+#include "psu-util/hash.h"
+#include "psu-io/IOStats.h"
+
+namespace psudb {
+
+/*
+ * The position of a record within a log, as a byte offset from the start
+ * of the file.
+ */
+typedef uint64_t LogSeqNum;
+
+/*
+ * Invalid log position, used to indicate a failed append.
+ */
+const LogSeqNum INVALID_LSN = UINT64_MAX;
+
+/*
+ * The default size, in bytes, of a log's append buffer. This bounds the
+ * amount of data written by a single commit, and the maximum record size.
+ */
+const size_t DEFAULT_LOG_BUFFER_SIZE = 1 << 20;
+
+/*
+ * The header stored ahead of each record in the log. The checksum covers
+ * the length field and the payload.
+ */
+struct LogRecordHeader {
+    uint32_t checksum;
+    uint32_t length;
+};
+
+class LogFile;
+
+class LogFileIterator {
+    friend class LogFile;
+
+public:
+    /*
+     * Advance to the next record in the log. Returns false once there are
+     * no further intact records.
+     */
+    bool next() {
+        if (m_started) {
+            m_pos += sizeof(LogRecordHeader) + m_length;
+        }
+        m_started = true;
+
+        if (m_pos + sizeof(LogRecordHeader) > m_end || !fill(m_pos, sizeof(LogRecordHeader))) {
+            return false;
+        }
+
+        LogRecordHeader header;
+        memcpy(&header, m_buffer + (m_pos - m_buffer_base), sizeof(header));
+
+        if (header.length == 0 || m_pos + sizeof(header) + header.length > m_end) {
+            return false;
+        }
+
+        if (!fill(m_pos, sizeof(header) + header.length)) {
+            return false;
+        }
+
+        const byte *rec = m_buffer + (m_pos - m_buffer_base);
+        uint32_t crc = crc32c(rec + offsetof(LogRecordHeader, length), sizeof(header.length) + header.length);
+        if (crc != header.checksum) {
+            return false;
+        }
+
+        m_length = header.length;
+        return true;
+    }
+
+    /*
+     * Returns a pointer to the payload of the current record. The pointer
+     * is invalidated by the next call to next.
+     */
+    const byte *get_item() const {
+        return m_buffer + (m_pos - m_buffer_base) + sizeof(LogRecordHeader);
+    }
+
+    /*
+     * Returns the length, in bytes, of the current record.
+     */
+    size_t get_length() const {
+        return m_length;
+    }
+
+    /*
+     * Returns the position of the current record.
+     */
+    LogSeqNum get_lsn() const {
+        return m_pos;
+    }
+
+    ~LogFileIterator() {
+        free(m_buffer);
+    }
+
+private:
+    /* the amount of the log read by each IO during a scan */
+    static constexpr size_t READ_SIZE = 64 * 1024;
+
+    int m_fd;
+    LogSeqNum m_pos;
+    LogSeqNum m_end;
+    size_t m_length;
+    bool m_started;
+
+    byte *m_buffer;
+    size_t m_buffer_cap;
+    LogSeqNum m_buffer_base;
+    size_t m_buffer_len;
+
+    LogFileIterator(int fd, LogSeqNum end)
+      : m_fd(fd), m_pos(0), m_end(end), m_length(0), m_started(false)
+      , m_buffer(nullptr), m_buffer_cap(0), m_buffer_base(0), m_buffer_len(0) {}
+
+    /*
+     * Ensure that the range [pos, pos + len) of the log is resident in
+     * the read buffer. Reads are sector aligned, so that the log can be
+     * opened with O_DIRECT.
+     */
+    bool fill(LogSeqNum pos, size_t len) {
+        if (pos >= m_buffer_base && pos + len <= m_buffer_base + m_buffer_len) {
+            return true;
+        }
+
+        LogSeqNum base = pos - (pos % SECTOR_SIZE);
+        size_t amount = std::max(TYPEALIGN(SECTOR_SIZE, pos + len - base), READ_SIZE);
+
+        if (amount > m_buffer_cap) {
+            free(m_buffer);
+            m_buffer = sf_aligned_alloc(SECTOR_SIZE, amount);
+            m_buffer_cap = amount;
+        }
+
+        ssize_t res = pread(m_fd, m_buffer, amount, base);
+        if (res < 0) {
+            m_buffer_len = 0;
+            return false;
+        }
+
+        m_buffer_base = base;
+        m_buffer_len = res;
+
+        return pos + len <= m_buffer_base + m_buffer_len;
+    }
+};
+
+
+class LogFile {
+public:
+    /*
+     * Open (or create) a log file. When an existing log is opened, it is
+     * scanned to locate the end of its intact records, and anything
+     * following them is discarded. buffer_size bounds the size of a single
+     * commit, and is rounded up to a multiple of SECTOR_SIZE. Returns nullptr
+     * if the file cannot be opened.
+     */
+    static std::unique_ptr<LogFile> create(const std::string fname, bool new_file=true, bool o_direct=true, size_t buffer_size=DEFAULT_LOG_BUFFER_SIZE) {
+        return std::unique_ptr<LogFile>(LogFile::setup(fname, new_file, o_direct, buffer_size));
+    }
+
+    /*
+     * Append a record to the log, and return its position. The record is
+     * not durable until a commit covering it has completed. If the append
+     * buffer is full, it is first written out (but not synced) to make
+     * room. Returns INVALID_LSN if the record is empty, is too large to fit
+     * within the append buffer, or if an IO error occurs.
+     *
+     * Safe to call concurrently with append and commit.
+     */
+    LogSeqNum append(const byte *data, size_t len) {
+        size_t rec_len = sizeof(LogRecordHeader) + len;
+        if (len == 0 || len > UINT32_MAX || rec_len > m_buffer_size - SECTOR_SIZE) {
+            return INVALID_LSN;
+        }
+
+        /* checksum outside of the lock, so that appenders only serialize on the copy */
+        LogRecordHeader header = {0, (uint32_t) len};
+        header.checksum = crc32c(data, len, crc32c((const byte *) &header.length, sizeof(header.length)));
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (m_active.len + rec_len > m_buffer_size) {
+            if (m_flushing) {
+                m_flushed.wait(lock);
+            } else if (!flush(lock, false)) {
+                return INVALID_LSN;
+            }
+        }
+
+        byte *rec = m_active.data + m_active.len;
+        memcpy(rec, &header, sizeof(header));
+        memcpy(rec + sizeof(header), data, len);
+
+        LogSeqNum lsn = m_active.base + m_active.len;
+        m_active.len += rec_len;
+
+        return lsn;
+    }
+
+    /*
+     * Make every record up to and including the one at lsn durable. If
+     * another thread is already committing, this waits for it to finish,
+     * and then commits any remaining records on behalf of every waiting
+     * thread at once. Returns 1 on success and 0 on an IO error.
+     *
+     * Passing INVALID_LSN commits every record appended so far.
+     */
+    int commit(LogSeqNum lsn=INVALID_LSN) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        LogSeqNum end = m_active.base + m_active.len;
+        LogSeqNum target = (lsn == INVALID_LSN || lsn >= end) ? end : lsn + 1;
+
+        while (m_durable < target) {
+            if (m_failed) {
+                return 0;
+            }
+
+            if (m_flushing) {
+                m_flushed.wait(lock);
+            } else if (!flush(lock, true)) {
+                return 0;
+            }
+        }
+
+        return 1;
+    }
+
+    /*
+     * Returns the position following the last durable record. Every
+     * record with a smaller position has been committed.
+     */
+    LogSeqNum get_durable_lsn() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_durable;
+    }
+
+    /*
+     * Returns an iterator over the durable records in the log, in the
+     * order in which they were appended.
+     */
+    std::unique_ptr<LogFileIterator> start_scan() {
+        return start_scan_to(get_durable_lsn());
+    }
+
+    /*
+     * Returns the IO statistics for this log.
+     */
+    IOStats &get_stats() {
+        return m_stats;
+    }
+
+    std::string get_fname() {
+        return m_fname;
+    }
+
+    /*
+     * Records which have been appended, but not committed, are discarded.
+     */
+    ~LogFile() {
+        close(m_fd);
+        free(m_active.data);
+        free(m_standby.data);
+    }
+
+private:
+    /*
+     * A contiguous region of the log, starting at the sector-aligned
+     * position base.
+     */
+    struct log_buffer {
+        byte *data;
+        LogSeqNum base;
+        size_t len;
+    };
+
+    int m_fd;
+    std::string m_fname;
+    size_t m_buffer_size;
+
+    std::mutex m_mutex;
+    std::condition_variable m_flushed;
+    bool m_flushing;
+    bool m_failed;
+
+    log_buffer m_active;
+    log_buffer m_standby;
+    LogSeqNum m_written;
+    LogSeqNum m_durable;
+
+    IOStats m_stats;
+
+    static LogFile *setup(const std::string fname, bool new_file, bool o_direct, size_t buffer_size) {
+        auto flags = O_RDWR | O_CREAT;
+
+        if (o_direct) {
+            flags |= O_DIRECT;
+        }
+
+        if (new_file) {
+            flags |= O_TRUNC;
+        }
+
+        int fd = open(fname.c_str(), flags, 0640);
+        if (fd == -1) {
+            return nullptr;
+        }
+
+        /* two sectors are needed to hold a partial tail sector and a record */
+        buffer_size = std::max(TYPEALIGN(SECTOR_SIZE, buffer_size), 2 * SECTOR_SIZE);
+        auto log = new LogFile(fd, fname, buffer_size);
+
+        if (!new_file && !log->recover()) {
+            delete log;
+            return nullptr;
+        }
+
+        return log;
+    }
+
+    LogFile(int fd, std::string fname, size_t buffer_size)
+      : m_fd(fd), m_fname(fname), m_buffer_size(buffer_size)
+      , m_flushing(false), m_failed(false)
+      , m_active({sf_aligned_alloc(SECTOR_SIZE, buffer_size), 0, 0})
+      , m_standby({sf_aligned_alloc(SECTOR_SIZE, buffer_size), 0, 0})
+      , m_written(0), m_durable(0), m_stats(SECTOR_SIZE) {}
+
+    /*
+     * Locate the end of the intact records in the log, discard everything
+     * following it, and load the final partial sector into the append
+     * buffer so that it is preserved by the next write.
+     */
+    bool recover() {
+        LogSeqNum end = 0;
+
+        auto itr = start_scan_to(UINT64_MAX);
+        while (itr->next()) {
+            end = itr->get_lsn() + sizeof(LogRecordHeader) + itr->get_length();
+        }
+
+        if (ftruncate(m_fd, end)) {
+            return false;
+        }
+
+        m_active.base = end - (end % SECTOR_SIZE);
+        m_active.len = end - m_active.base;
+
+        if (m_active.len > 0 && pread(m_fd, m_active.data, SECTOR_SIZE, m_active.base) < (ssize_t) m_active.len) {
+            return false;
+        }
+
+        m_written = end;
+        m_durable = end;
+        return true;
+    }
+
+    std::unique_ptr<LogFileIterator> start_scan_to(LogSeqNum end) {
+        return std::unique_ptr<LogFileIterator>(new LogFileIterator(m_fd, end));
+    }
+
+    /*
+     * Write out the contents of the active buffer, and sync them if sync
+     * is true. Must be called with lock held, and with no other flush in
+     * progress. The lock is released while the IO is performed, so that
+     * other threads can continue to append into the standby buffer.
+     */
+    bool flush(std::unique_lock<std::mutex> &lock, bool sync) {
+        LogSeqNum end = m_active.base + m_active.len;
+
+        /* nothing new to write, but it may still need to be synced */
+        if (end == m_written && (!sync || m_durable == end)) {
+            return true;
+        }
+
+        log_buffer out = m_active;
+        m_flushing = true;
+
+        /*
+         * The final sector of the flushed region may be only partially
+         * filled. It is carried over into the new active buffer, so that
+         * the next flush rewrites it along with the records that follow.
+         */
+        size_t tail = out.len % SECTOR_SIZE;
+        m_active = {m_standby.data, end - tail, tail};
+        memcpy(m_active.data, out.data + (out.len - tail), tail);
+
+        lock.unlock();
+
+        size_t amount = TYPEALIGN(SECTOR_SIZE, out.len);
+        memset(out.data + out.len, 0, amount - out.len);
+
+        auto start = IOStats::now();
+        bool success = true;
+        size_t syscalls = 0;
+
+        if (end != m_written) {
+            success = pwrite(m_fd, out.data, amount, out.base) == (ssize_t) amount;
+            syscalls++;
+        }
+
+        if (success && sync) {
+            success = fdatasync(m_fd) == 0;
+            syscalls++;
+        }
+
+        if (success) {
+            m_stats.record(IO_OP_WRITE, amount, syscalls, start);
+        }
+
+        lock.lock();
+
+        m_standby.data = out.data;
+        m_flushing = false;
+        m_failed |= !success;
+
+        if (success) {
+            m_written = end;
+            if (sync) {
+                m_durable = end;
+            }
+        }
+
+        m_flushed.notify_all();
+        return success;
+    }
+};
+
+}
@@ -14,123 +14,329 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <span>
+#include <climits>
+#include <atomic>
 
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <linux/falloc.h>
 #include <memory>
 
 #include "psu-util/alignment.h"
+#include "psu-util/hash.h"
+#include "psu-util/zbuff.h"
 #include "psu-io/IOTypes.h"
-#include "psu-io/IOCounter.h"
+#include "psu-io/IOStats.h"
+#include "psu-io/IOUring.h"
 
 namespace psudb {
 
 class PagedFile;
 class PagedFileIterator;
-extern std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum);
+extern std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum, size_t, size_t);
 
 
+/*
+ * The default maximum number of unrequested pages that PagedFile::read_pages
+ * will read in order to merge two requested pages into a single IO.
+ */
+const PageNum DEFAULT_COALESCE_GAP = 4;
+
+/*
+ * The trailer stored in the final bytes of each page of a file with
+ * checksums enabled. The checksum covers the entire page up to (but not
+ * including) itself, so that a page written to the wrong location is
+ * detected as well as one which is torn or corrupted.
+ */
+struct PageTrailer {
+    PageNum pnum;
+    uint32_t checksum;
+};
+
+/*
+ * The maximum number of pages copied and stamped at once when writing
+ * to a file with checksums enabled.
+ */
+const size_t CHECKSUM_WRITE_BATCH = 32;
+
+/*
+ * Reusable scratch space for batched reads. Holds an array of iovecs, and a
+ * sector-aligned discard buffer into which unrequested pages can be read. Both
+ * grow as needed, but are never shrunk, so that a single arena can be used
+ * for many reads without further allocation.
+ */
+class IOVecArena {
+public:
+    IOVecArena() : m_discard(nullptr), m_discard_size(0) {}
+
+    IOVecArena(const IOVecArena &) = delete;
+    IOVecArena &operator=(const IOVecArena &) = delete;
+
+    ~IOVecArena() {
+        free(m_discard);
+    }
+
+    iovec *get_iovecs(size_t cnt) {
+        if (m_iov.size() < cnt) {
+            m_iov.resize(cnt);
+        }
+
+        return m_iov.data();
+    }
+
+    byte *get_discard(size_t size) {
+        if (m_discard_size < size) {
+            free(m_discard);
+            m_discard = sf_aligned_alloc(SECTOR_SIZE, size);
+            m_discard_size = size;
+        }
+
+        return m_discard;
+    }
+
+private:
+    std::vector<iovec> m_iov;
+    byte *m_discard;
+    size_t m_discard_size;
+};
+
+
+/*
+ * A file accessed in fixed-size pages.
+ *
+ * Concurrency: the synchronous read and write methods, allocate_pages,
+ * and the accessors for the file's size may be called from any number of
+ * threads at once, provided that no two threads write the same page
+ * concurrently. Allocation is lock-free--each call atomically reserves a
+ * distinct range of pages, and the new pages become visible to other
+ * threads once the backing space has been allocated. The async_* methods,
+ * read_pages using the file's internal arena, and remove_file and
+ * rename_file are not thread-safe, and require external synchronization.
+ */
 class PagedFile {
 public:
-    static std::shared_ptr<PagedFile> create_shared(const std::string fname, bool new_file=true, bool o_direct=true) {
-        return std::shared_ptr<PagedFile>(PagedFile::setup(fname, new_file, o_direct));
+    /*
+     * Open (or create) a paged file. All IO against the file is performed
+     * in units of page_size bytes, which must satisfy is_valid_page_size.
+     * The page size is not recorded within the file, and so an existing file
+     * must be opened using the same page size with which it was written.
+     * Returns nullptr if the file cannot be opened, or if the page size is
+     * invalid.
+     */
+    static std::shared_ptr<PagedFile> create_shared(const std::string fname, bool new_file=true, bool o_direct=true, size_t page_size=PAGE_SIZE) {
+        return std::shared_ptr<PagedFile>(PagedFile::setup(fname, new_file, o_direct, page_size));
+    }
+
+    static std::unique_ptr<PagedFile> create(const std::string fname, bool new_file=true, bool o_direct=true, size_t page_size=PAGE_SIZE) {
+        return std::unique_ptr<PagedFile>(PagedFile::setup(fname, new_file, o_direct, page_size));
     }
 
-    static std::unique_ptr<PagedFile> create(const std::string fname, bool new_file=true, bool o_direct=true) {
-        return std::unique_ptr<PagedFile>(PagedFile::setup(fname, new_file, o_direct));
+    /*
+     * Open an existing file in read-only, memory-mapped mode. The entire file
+     * is mapped into memory, and pages can be accessed in place using
+     * view_page, without any system calls or copying. The access hint is
+     * passed along to the kernel via madvise, and can be changed later using
+     * advise. Returns nullptr if the file cannot be opened or mapped.
+     *
+     * In this mode, the file cannot be written to or extended; all write
+     * and allocation operations will fail.
+     */
+    static std::unique_ptr<PagedFile> create_mapped(const std::string fname, MapAdvice advice=ADVISE_RANDOM, size_t page_size=PAGE_SIZE) {
+        return std::unique_ptr<PagedFile>(PagedFile::setup_mapped(fname, advice, page_size));
     }
 
     /*
-     * Add new_page_count new pages to the file in bulk, and returns the
-     * PageId of the first page in the new range. 
+     * Add count new pages to the file in bulk, and returns the PageNum of
+     * the first page in the new range. Safe to call concurrently; each
+     * caller receives a distinct range of pages.
      *
-     * If the allocation fails, returns INVALID_PID. Also returns INVALID_PID
-     * if bulk allocation is not supported by the implementation. This can be
-     * checked via the supports_allocation method.
+     * If the allocation fails, returns INVALID_PNUM. A failed allocation
+     * may still consume its range of page numbers, in which case those
+     * pages will be made valid by the next successful allocation.
      */
     PageNum allocate_pages(PageNum count=1) {
-        PageNum new_first = get_page_count() + 1;
-        size_t alloc_size = count * PAGE_SIZE;
+        if (count == 0 || !m_file_open || m_read_only) {
+            return INVALID_PNUM;
+        }
+
+        off_t amount = (off_t) count * m_page_size;
+        off_t start = m_reserved.fetch_add(amount, std::memory_order_relaxed);
 
-        if (raw_allocate(alloc_size)) {
-            return new_first;
+        if (!raw_allocate(start + amount)) {
+            return INVALID_PNUM;
         }
 
-        return INVALID_PNUM;
+        return start / m_page_size;
+    }
+
+    /*
+     * Set the number of pages by which the backing file is grown when
+     * allocate_pages runs past its current extent. Allocations that fall
+     * within space that has already been grown do not require a system
+     * call. Any space beyond the last allocated page is released when the
+     * file is closed. The default of 0 grows the file by exactly the
+     * amount requested by each allocation.
+     */
+    void set_preallocation(PageNum page_cnt) {
+        m_prealloc_pages.store(page_cnt, std::memory_order_relaxed);
     }
 
     /*
      * Reads data from the specified page into a buffer pointed to by
-     * buffer_ptr. It is necessary for buffer_ptr to be parm::SECTOR_SIZE
+     * buffer_ptr. It is necessary for buffer_ptr to be SECTOR_SIZE
      * aligned, and also for it to be large enough to accommodate
-     * parm::PAGE_SIZE bytes. If the read succeeds, returns 1. Otherwise
+     * get_page_size() bytes. If the read succeeds, returns 1. Otherwise
      * returns 0. The contents of the input buffer are undefined in the case of
      * an error.
      */
     int read_page(PageNum pnum, byte *buffer_ptr) {
         if (check_pnum(pnum)) {
-            return raw_read(buffer_ptr, PAGE_SIZE, pnum_to_offset(pnum));
+            return raw_read(buffer_ptr, m_page_size, pnum_to_offset(pnum, m_page_size))
+                && (!m_checksums || verify_page(pnum, buffer_ptr));
         }
 
         return 0;
     }
 
+    /*
+     * Returns a pointer to the contents of the specified page, for files
+     * opened using create_mapped. The returned pointer is valid for as long
+     * as this object exists. Returns nullptr if pnum is not a valid page, or
+     * if the file is not memory-mapped. The page is not checked against
+     * its checksum; use verify_page if this is needed.
+     */
+    const byte *view_page(PageNum pnum) const {
+        if (m_map && check_pnum(pnum)) {
+            return m_map + pnum_to_offset(pnum, m_page_size);
+        }
+
+        return nullptr;
+    }
+
+    /*
+     * Update the access pattern hint for a memory-mapped file. Returns 1 on
+     * success, and 0 on failure or if the file is not memory-mapped.
+     */
+    int advise(MapAdvice advice) {
+        if (!m_map) {
+            return 0;
+        }
+
+        return madvise(m_map, get_file_size(), advice_flag(advice)) == 0;
+    }
+
+    /*
+     * Returns true if this file was opened using create_mapped.
+     */
+    bool is_mapped() const {
+        return m_map != nullptr;
+    }
+
     /*
      * Reads several pages into associated buffers. It is necessary for the
-     * buffer referred to by each pointer to be parm::SECTOR_SIZE aligned and
-     * large enough to accommodate parm::PAGE_SIZE bytes. If possible,
-     * vectorized IO may be used to read adjacent pages. If the reads succeed,
+     * buffer referred to by each pointer to be SECTOR_SIZE aligned and
+     * large enough to accommodate get_page_size() bytes. If the reads succeed,
      * returns 1. If a read fails, returns 0. The contents of all the buffers
      * are undefined in the case of an error.
+     *
+     * The entries in pages are sorted in place by page number. Pages that are
+     * at most max_gap pages apart are read using a single vectored IO, with
+     * the pages in between read into a discard buffer. The iovecs and discard
+     * buffer are taken from arena, so that repeated calls using the same
+     * arena do not allocate.
      */
-    int read_pages(std::vector<std::pair<PageNum, byte*>> pages) {
+    int read_pages(std::span<std::pair<PageNum, byte*>> pages, IOVecArena &arena, PageNum max_gap=DEFAULT_COALESCE_GAP) {
         if (pages.size() == 0) {
             return 0;
         }
 
         if (pages.size() == 1) {
-            read_page(pages[0].first, pages[0].second);
+            return read_page(pages[0].first, pages[0].second);
         }
 
-        std::sort(pages.begin(), pages.end());
+        if (!std::is_sorted(pages.begin(), pages.end())) {
+            std::sort(pages.begin(), pages.end());
+        }
 
-        PageNum range_start = pages[0].first;
-        PageNum prev_pnum = range_start;
+        /* the pages are sorted, so checking the endpoints is sufficient */
+        if (!check_pnum(pages.front().first) || !check_pnum(pages.back().first)) {
+            return 0;
+        }
+
+        /* each page may require a second iovec to cover the gap before it */
+        size_t iov_cap = std::min<size_t>(2 * pages.size(), IOV_MAX);
+        iovec *iov = arena.get_iovecs(iov_cap);
+        byte *discard = (max_gap > 0) ? arena.get_discard(max_gap * m_page_size) : nullptr;
 
-        std::vector<byte *> buffers;
-        buffers.push_back(pages[0].second);
+        size_t iov_cnt = 0;
+        PageNum run_start = pages[0].first;
+        PageNum prev_pnum = run_start;
+        iov[iov_cnt++] = {pages[0].second, m_page_size};
 
         for (size_t i=1; i<pages.size(); i++) {
-            if (pages[i].first == prev_pnum + 1) {
-                buffers.push_back(pages[i].second);
-                prev_pnum = pages[i].first;
-            } else {
-                if (!raw_readv(buffers, PAGE_SIZE, pnum_to_offset(range_start))) {
+            PageNum pnum = pages[i].first;
+            PageNum gap = pnum - prev_pnum - 1;
+
+            /* 
+             * Duplicate page numbers start a new run, as a single read cannot
+             * place the same page into two buffers.
+             */
+            bool coalesce = pnum > prev_pnum && gap <= max_gap;
+            size_t needed = (gap > 0) ? 2 : 1;
+
+            if (!coalesce || iov_cnt + needed > iov_cap) {
+                if (!raw_readv(iov, iov_cnt, pnum_to_offset(run_start, m_page_size))) {
                     return 0;
                 }
 
-                range_start = pages[i].first;
-                prev_pnum = range_start;
+                iov_cnt = 0;
+                run_start = pnum;
+            } else if (gap > 0) {
+                iov[iov_cnt++] = {discard, gap * m_page_size};
+            }
+
+            iov[iov_cnt++] = {pages[i].second, m_page_size};
+            prev_pnum = pnum;
+        }
+
+        if (!raw_readv(iov, iov_cnt, pnum_to_offset(run_start, m_page_size))) {
+            return 0;
+        }
 
-                buffers.clear();
-                buffers.push_back(pages[i].second);
+        if (m_checksums) {
+            for (auto &pg : pages) {
+                if (!verify_page(pg.first, pg.second)) {
+                    return 0;
+                }
             }
         }
 
-        return raw_readv(buffers, PAGE_SIZE, pnum_to_offset(range_start));
+        return 1;
+    }
+
+    /*
+     * As above, but using an arena owned by this file. Not safe for use by
+     * multiple threads at once.
+     */
+    int read_pages(std::span<std::pair<PageNum, byte*>> pages) {
+        return read_pages(pages, m_read_arena);
     }
 
     /*
      * Reads several pages stored contiguously into a single buffer. It is 
      * necessary that buffer_ptr be SECTOR_SIZE aligned and also
-     * at least page_cnt * PAGE_SIZE bytes large.
+     * at least page_cnt * get_page_size() bytes large.
      */
     int read_pages(PageNum first_page, size_t page_cnt, byte *buffer_ptr) {
         if (check_pnum(first_page) && check_pnum(first_page + page_cnt - 1)) {
-            return raw_read(buffer_ptr, page_cnt * PAGE_SIZE, first_page * PAGE_SIZE); 
+            return raw_read(buffer_ptr, page_cnt * m_page_size, pnum_to_offset(first_page, m_page_size))
+                && (!m_checksums || verify_pages(first_page, page_cnt, buffer_ptr));
         }
 
         return 0;
@@ -138,9 +344,9 @@ public:
 
     /*
      * Writes data from the provided buffer into the specified page within the
-     * file. It is necessary for buffer_ptr to be parm::SECTOR_SIZE aligned,
-     * and also for it to be at least parm::PAGE_SIZE bytes large. If it is
-     * larger, only the first parm::PAGE_SIZE bytes will be written. If it is
+     * file. It is necessary for buffer_ptr to be SECTOR_SIZE aligned,
+     * and also for it to be at least get_page_size() bytes large. If it is
+     * larger, only the first get_page_size() bytes will be written. If it is
      * smaller, the result is undefined.
      *
      * If the write succeeds, returns 1. Otherwise returns 0. The contents of
@@ -148,7 +354,7 @@ public:
      */
     int write_page(PageNum pnum, const byte *buffer_ptr) {
         if (check_pnum(pnum)) {
-            return raw_write(buffer_ptr, PAGE_SIZE, pnum_to_offset(pnum));
+            return write_stamped(pnum, 1, buffer_ptr);
         }
 
         return 0;
@@ -160,23 +366,340 @@ public:
      * would overrun the allocated space in the file, no data is written.
      *
      * It is necessary for buffer_ptr to be SECTOR_SIZE aligned, and at 
-     * least PAGE_SIZE * page_cnt bytes large.
+     * least get_page_size() * page_cnt bytes large.
      *
      * Returns the number of complete pages successfully written.
      */
     int write_pages(PageNum first_page, size_t page_cnt, const byte *buffer_ptr) {
         if (check_pnum(first_page) && check_pnum(first_page + page_cnt - 1)) {
-           return raw_write(buffer_ptr, page_cnt * PAGE_SIZE, first_page * PAGE_SIZE); 
+            return write_stamped(first_page, page_cnt, buffer_ptr);
         }
 
         return 0;
     }
 
+    /*
+     * Enable page checksums for this file. Each page written is stamped with
+     * a trailer (see PageTrailer) containing its page number and a CRC-32C
+     * checksum, which is verified whenever the page is read. A read of a
+     * page which fails verification also fails, as does an asynchronous
+     * read containing such a page. Pages which have never been written
+     * (and are entirely zero) pass verification.
+     *
+     * The final sizeof(PageTrailer) bytes of each page are reserved for the
+     * trailer, and any data placed there by the caller is overwritten. The
+     * caller's buffer is not modified; pages are stamped in a copy. Whether
+     * checksums are enabled is not recorded in the file, and so this must be
+     * called before any IO is performed, every time the file is opened.
+     */
+    void enable_checksums() {
+        m_checksums = true;
+    }
+
+    /*
+     * Returns true if enable_checksums has been called on this file.
+     */
+    bool has_checksums() const {
+        return m_checksums;
+    }
+
+    /*
+     * Returns the number of bytes of each page available to the caller,
+     * accounting for the checksum trailer if checksums are enabled.
+     */
+    size_t get_payload_size() const {
+        return m_checksums ? m_page_size - sizeof(PageTrailer) : m_page_size;
+    }
+
+    /*
+     * Check the trailer of a page that has been read from page pnum of this
+     * file. Returns true if it is valid, or if the page has never been
+     * written. Failures are counted in this file's IO statistics.
+     */
+    bool verify_page(PageNum pnum, const byte *page) {
+        PageTrailer trailer;
+        memcpy(&trailer, page + m_page_size - sizeof(trailer), sizeof(trailer));
+
+        bool valid;
+        if (trailer.pnum == INVALID_PNUM && trailer.checksum == 0) {
+            valid = memcmp(page, ZEROBUFF, m_page_size) == 0;
+        } else {
+            valid = trailer.pnum == pnum && trailer.checksum == page_checksum(page);
+        }
+
+        if (!valid) {
+            m_stats.record_checksum_failure();
+        }
+
+        return valid;
+    }
+
+    /*
+     * Check the trailers of page_cnt pages read contiguously into buffer,
+     * starting from first_page. Returns true if all are valid.
+     */
+    bool verify_pages(PageNum first_page, size_t page_cnt, const byte *buffer) {
+        for (size_t i=0; i<page_cnt; i++) {
+            if (!verify_page(first_page + i, buffer + i * m_page_size)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*
+     * Release the storage backing a range of pages to the filesystem by
+     * punching a hole in the file. The pages remain allocated, and will
+     * read as zeroes until they are next written. Returns 1 on success,
+     * and 0 on failure or if the filesystem does not support hole punching.
+     */
+    int discard_pages(PageNum first_page, size_t page_cnt) {
+        if (m_read_only || page_cnt == 0 || !check_pnum(first_page) || !check_pnum(first_page + page_cnt - 1)) {
+            return 0;
+        }
+
+        return fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                         pnum_to_offset(first_page, m_page_size), page_cnt * m_page_size) == 0;
+    }
+
+    /*
+     * Initialize asynchronous IO support for this file, backed by an
+     * io_uring instance permitting up to depth outstanding requests. This
+     * must be called prior to using any of the async_* methods. Returns 1
+     * on success, and 0 if asynchronous IO is not supported on this system.
+     */
+    int enable_async_io(unsigned depth=64) {
+        if (m_ring) {
+            return 1;
+        }
+
+        m_ring = IOUring::create(depth);
+        return m_ring != nullptr;
+    }
+
+    /*
+     * Returns true if enable_async_io has been successfully called on
+     * this file.
+     */
+    bool supports_async_io() const {
+        return m_ring != nullptr;
+    }
+
+    /*
+     * Asynchronous equivalent of read_page. Queues a read of the specified
+     * page into buffer_ptr, and returns a token that can be used to check
+     * its status via async_poll or async_wait. The request will not be
+     * issued to the device until async_submit is called (or until the
+     * queue fills up). Returns INVALID_IOTOKEN if the request could not
+     * be queued.
+     *
+     * buffer_ptr must remain valid, and must not be accessed, until the
+     * request has completed.
+     */
+    IOToken async_read_page(PageNum pnum, byte *buffer_ptr) {
+        return async_read_pages(pnum, 1, buffer_ptr);
+    }
+
+    /*
+     * Asynchronous equivalent of read_pages(first_page, page_cnt, buffer_ptr).
+     * The same buffer requirements apply.
+     */
+    IOToken async_read_pages(PageNum first_page, size_t page_cnt, byte *buffer_ptr) {
+        if (page_cnt == 0 || !check_pnum(first_page) || !check_pnum(first_page + page_cnt - 1)) {
+            return INVALID_IOTOKEN;
+        }
+
+        off_t amount = page_cnt * m_page_size;
+        off_t offset = pnum_to_offset(first_page, m_page_size);
+        if (!verify_io_parms(amount, offset) || !reserve_async_slots(1)) {
+            return INVALID_IOTOKEN;
+        }
+
+        IOToken tok = m_next_token++;
+        m_async_reqs[tok] = {1, amount, 0, false, {}, IO_OP_READ, IOStats::now(), first_page, buffer_ptr};
+        m_ring->queue_read(m_fd, buffer_ptr, amount, offset, tok);
+        m_async_outstanding++;
+
+        return tok;
+    }
+
+    /*
+     * Asynchronous equivalent of read_pages for a set of (possibly
+     * non-contiguous) pages. Runs of adjacent pages are issued as a
+     * single vectored read (or several, for runs longer than IOV_MAX
+     * pages), and the returned token completes once all
+     * of the pages have been read. Returns INVALID_IOTOKEN if any of the
+     * pages is invalid, or if the request requires more operations than
+     * can be outstanding at once.
+     */
+    IOToken async_read_pages(std::vector<std::pair<PageNum, byte*>> pages) {
+        if (pages.size() == 0 || !m_ring) {
+            return INVALID_IOTOKEN;
+        }
+
+        std::sort(pages.begin(), pages.end());
+
+        for (auto &pg : pages) {
+            if (!check_pnum(pg.first)) {
+                return INVALID_IOTOKEN;
+            }
+        }
+
+        /*
+         * Build the iovecs for every run of adjacent pages up front. They
+         * are stored alongside the request, as they must remain valid
+         * until the kernel has consumed them.
+         */
+        async_request req = {0, (off_t) (pages.size() * m_page_size), 0, false, {}, IO_OP_READ, IOStats::now()};
+        std::vector<std::pair<size_t, PageNum>> runs;
+
+        req.iov.resize(pages.size());
+        req.pnums.resize(pages.size());
+        for (size_t i=0; i<pages.size(); i++) {
+            req.iov[i].iov_base = pages[i].second;
+            req.iov[i].iov_len = m_page_size;
+            req.pnums[i] = pages[i].first;
+
+            /* a single readv accepts at most IOV_MAX iovecs */
+            if (i == 0 || pages[i].first != pages[i-1].first + 1 || i - runs.back().first >= IOV_MAX) {
+                runs.push_back({i, pages[i].first});
+            }
+        }
+
+        if (!reserve_async_slots(runs.size())) {
+            return INVALID_IOTOKEN;
+        }
+
+        IOToken tok = m_next_token++;
+        req.pending = runs.size();
+        auto &stored = m_async_reqs[tok] = std::move(req);
+
+        for (size_t i=0; i<runs.size(); i++) {
+            size_t iov_cnt = ((i + 1 < runs.size()) ? runs[i+1].first : pages.size()) - runs[i].first;
+            m_ring->queue_readv(m_fd, stored.iov.data() + runs[i].first, iov_cnt, pnum_to_offset(runs[i].second, m_page_size), tok);
+            m_async_outstanding++;
+        }
+
+        return tok;
+    }
+
+    /*
+     * Asynchronous equivalent of write_page. buffer_ptr must remain
+     * valid, and must not be modified, until the request has completed.
+     */
+    IOToken async_write_page(PageNum pnum, const byte *buffer_ptr) {
+        return async_write_pages(pnum, 1, buffer_ptr);
+    }
+
+    /*
+     * Asynchronous equivalent of write_pages. The same buffer
+     * requirements apply.
+     */
+    IOToken async_write_pages(PageNum first_page, size_t page_cnt, const byte *buffer_ptr) {
+        if (m_read_only || page_cnt == 0 || !check_pnum(first_page) || !check_pnum(first_page + page_cnt - 1)) {
+            return INVALID_IOTOKEN;
+        }
+
+        off_t amount = page_cnt * m_page_size;
+        off_t offset = pnum_to_offset(first_page, m_page_size);
+        if (!verify_io_parms(amount, offset) || !reserve_async_slots(1)) {
+            return INVALID_IOTOKEN;
+        }
+
+        IOToken tok = m_next_token++;
+        auto &req = m_async_reqs[tok] = {1, amount, 0, false, {}, IO_OP_WRITE, IOStats::now()};
+
+        /* the stamped copy must live until the write completes */
+        if (m_checksums) {
+            req.bounce.reset(sf_aligned_alloc(SECTOR_SIZE, amount));
+            memcpy(req.bounce.get(), buffer_ptr, amount);
+            for (size_t i=0; i<page_cnt; i++) {
+                stamp_page(first_page + i, get_page(req.bounce.get(), i, m_page_size));
+            }
+
+            buffer_ptr = req.bounce.get();
+        }
+
+        m_ring->queue_write(m_fd, buffer_ptr, amount, offset, tok);
+        m_async_outstanding++;
+
+        return tok;
+    }
+
+    /*
+     * Issue all queued asynchronous requests to the device. Returns
+     * the number of requests issued, or -1 on error.
+     */
+    int async_submit() {
+        if (!m_ring) {
+            return -1;
+        }
+
+        return submit_async();
+    }
+
+    /*
+     * Check the status of an asynchronous request without blocking.
+     * Returns IO_PENDING if the request has not yet completed. Otherwise,
+     * returns IO_SUCCESS or IO_FAILED, and the token is released--it is
+     * not valid to poll or wait on it again.
+     */
+    IOStatus async_poll(IOToken tok) {
+        auto itr = m_async_reqs.find(tok);
+        if (itr == m_async_reqs.end()) {
+            return IO_FAILED;
+        }
+
+        reap_async_completions(false);
+
+        if (itr->second.pending > 0) {
+            return IO_PENDING;
+        }
+
+        return release_async_request(itr);
+    }
+
+    /*
+     * Block until the specified asynchronous request completes, submitting
+     * it first if necessary. Returns IO_SUCCESS or IO_FAILED, and releases
+     * the token.
+     */
+    IOStatus async_wait(IOToken tok) {
+        auto itr = m_async_reqs.find(tok);
+        if (itr == m_async_reqs.end()) {
+            return IO_FAILED;
+        }
+
+        while (itr->second.pending > 0) {
+            if (submit_async() < 0 || !reap_async_completions(true)) {
+                return IO_FAILED;
+            }
+        }
+
+        return release_async_request(itr);
+    }
+
+    /*
+     * Returns the IO statistics for this file. These are also included
+     * in the totals reported by IOStatsRegistry.
+     */
+    IOStats &get_stats() {
+        return m_stats;
+    }
+
     /*
      * Returns the number of allocated paged in the file.
      */
-    PageNum get_page_count() {
-        return m_size / PAGE_SIZE - 1;
+    PageNum get_page_count() const {
+        return get_file_size() / m_page_size - 1;
+    }
+
+    /*
+     * Returns the size, in bytes, of the pages of this file.
+     */
+    size_t get_page_size() const {
+        return m_page_size;
     }
 
     /*
@@ -185,6 +708,8 @@ public:
      * undefined. Returns 1 on successful removal of the file, and 0 on failure.
      */
     int remove_file() {
+        drain_async_requests();
+
         if (m_file_open) {
             close(m_fd);
         }
@@ -200,19 +725,32 @@ public:
 
 
     /*
-     * Returns the raw number of bytes allocated in the backing file.
+     * Returns the raw number of bytes allocated in the backing file. This
+     * does not include any space that has been preallocated, but not yet
+     * handed out by allocate_pages.
      */
     off_t get_file_size() const {
-        return m_size;
+        return m_size.load(std::memory_order_acquire);
     }
 
-    std::unique_ptr<PagedFileIterator> start_scan(PageNum start_page=1, PageNum end_page=0) {
+    /*
+     * Returns an iterator over the pages in the range [start_page, end_page].
+     * If end_page is INVALID_PNUM, the scan will run to the end of the file.
+     * Returns nullptr if the range is invalid.
+     *
+     * Pages are read in batches of batch_size pages. If asynchronous IO has
+     * been enabled on this file, up to batch_cnt batches will be kept in
+     * flight at once, so that subsequent batches are read while the current
+     * one is being processed. Otherwise, each batch is read synchronously
+     * when it is reached.
+     */
+    std::unique_ptr<PagedFileIterator> start_scan(PageNum start_page=1, PageNum end_page=0, size_t batch_size=1, size_t batch_cnt=2) {
         if (end_page == INVALID_PNUM) {
             end_page = get_page_count();
         }
 
         if (check_pnum(start_page) && check_pnum(end_page)) {
-            return create_pagedfile_itr(this, start_page, end_page);
+            return create_pagedfile_itr(this, start_page, end_page, batch_size, batch_cnt);
         }
 
         return nullptr;
@@ -233,14 +771,54 @@ public:
     }
 
     ~PagedFile() {
+        /*
+         * Outstanding requests may still reference caller-owned buffers, so
+         * they must be allowed to finish before the file is torn down.
+         */
+        drain_async_requests();
+
+        if (m_map) {
+            munmap(m_map, get_file_size());
+        }
+
         if (m_file_open) {
+            /* release any preallocated space beyond the last page */
+            if (m_allocated.load() > get_file_size()) {
+                (void) ftruncate(m_fd, get_file_size());
+            }
+
             close(m_fd);
         }
     }
 
 private:
+    struct buffer_deleter {
+        void operator()(byte *ptr) const { free(ptr); }
+    };
+
+    struct async_request {
+        size_t pending;
+        off_t expected;
+        off_t completed;
+        bool failed;
+        std::vector<iovec> iov;
+        IOOpType type;
+        IOStats::time_point start;
+
+        /* the destination of a contiguous read, or the pages of a scattered one */
+        PageNum first_pnum = INVALID_PNUM;
+        byte *buffer = nullptr;
+        std::vector<PageNum> pnums;
+
+        /* a stamped copy of the data for a write, when checksums are enabled */
+        std::unique_ptr<byte, buffer_deleter> bounce;
+    };
+
+    static PagedFile *setup(const std::string fname, bool new_file, bool o_direct, size_t page_size) {
+        if (!is_valid_page_size(page_size)) {
+            return nullptr;
+        }
 
-    static PagedFile *setup(const std::string fname, bool new_file, bool o_direct) {
         auto flags = O_RDWR;
 
         if (o_direct) {
@@ -260,11 +838,11 @@ private:
         }
         
         if (new_file) {
-            if(fallocate(fd, 0, 0, PAGE_SIZE)) {
+            if(fallocate(fd, 0, 0, page_size)) {
                 return nullptr;
             }
 
-            size = PAGE_SIZE;
+            size = page_size;
         } else {
             struct stat buf;
             if (fstat(fd, &buf) == -1) {
@@ -275,22 +853,63 @@ private:
         } 
 
         if (fd) {
-            return new PagedFile(fd, fname, size, mode);
+            return new PagedFile(fd, fname, size, mode, page_size);
         }
 
         return nullptr;
     }
 
-    PagedFile(int fd, std::string fname, off_t size, mode_t mode) {
+    static PagedFile *setup_mapped(const std::string fname, MapAdvice advice, size_t page_size) {
+        if (!is_valid_page_size(page_size)) {
+            return nullptr;
+        }
+
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return nullptr;
+        }
+
+        struct stat buf;
+        if (fstat(fd, &buf) == -1 || buf.st_size == 0) {
+            close(fd);
+            return nullptr;
+        }
+
+        void *map = mmap(nullptr, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+
+        auto pfile = new PagedFile(fd, fname, buf.st_size, buf.st_mode, page_size);
+        pfile->m_map = (byte *) map;
+        pfile->m_read_only = true;
+        pfile->advise(advice);
+
+        return pfile;
+    }
+
+    static int advice_flag(MapAdvice advice) {
+        switch (advice) {
+            case ADVISE_SEQUENTIAL: return MADV_SEQUENTIAL;
+            case ADVISE_RANDOM:     return MADV_RANDOM;
+            case ADVISE_WILLNEED:   return MADV_WILLNEED;
+            default:                return MADV_NORMAL;
+        }
+    }
+
+    PagedFile(int fd, std::string fname, off_t size, mode_t mode, size_t page_size)
+      : m_size(size), m_reserved(size), m_allocated(size), m_prealloc_pages(0)
+      , m_page_size(page_size), m_map(nullptr), m_read_only(false), m_checksums(false), m_stats(page_size)
+      , m_next_token(INVALID_IOTOKEN + 1), m_async_outstanding(0) {
         m_file_open = true;
         m_fd = fd;
         m_fname = fname;
-        m_size = size;
         m_mode = mode;
     }
 
     bool check_pnum(PageNum pnum) const {
-        return pnum != INVALID_PNUM && pnum < (get_file_size() / PAGE_SIZE);
+        return pnum != INVALID_PNUM && pnum < (get_file_size() / m_page_size);
     }
 
     int raw_read(byte *buffer, off_t amount, off_t offset) {
@@ -298,71 +917,235 @@ private:
             return 0;
         }
 
-        if (pread(m_fd, buffer, amount, offset) != amount) {
+        auto start = IOStats::now();
+
+        if (m_map) {
+            memcpy(buffer, m_map + offset, amount);
+        } else if (pread(m_fd, buffer, amount, offset) != amount) {
             return 0;
         }
 
-        INC_READ();
+        m_stats.record(IO_OP_READ, amount, !m_map, start);
 
         return 1;
     }
 
-    int raw_readv(std::vector<byte *> buffers, off_t buffer_size, off_t initial_offset) {
-        size_t buffer_cnt = buffers.size();
+    int raw_readv(const iovec *iov, size_t iov_cnt, off_t initial_offset) {
+        off_t amount = 0;
+        for (size_t i=0; i<iov_cnt; i++) {
+            amount += iov[i].iov_len;
+        }
 
-        off_t amount = buffer_size * buffer_cnt;
         if (!verify_io_parms(amount, initial_offset)) {
             return 0;
         }
 
-        auto iov = new iovec[buffer_cnt];
-        for (size_t i=0; i<buffer_cnt; i++) {
-            iov[i].iov_base = buffers[i];
-            iov[i].iov_len = buffer_size;
-        }
+        auto start = IOStats::now();
 
-        if (preadv(m_fd, iov, buffer_cnt, initial_offset) != amount) {
+        if (m_map) {
+            off_t offset = initial_offset;
+            for (size_t i=0; i<iov_cnt; i++) {
+                memcpy(iov[i].iov_base, m_map + offset, iov[i].iov_len);
+                offset += iov[i].iov_len;
+            }
+        } else if (preadv(m_fd, iov, iov_cnt, initial_offset) != amount) {
             return 0;
         }
 
-        INC_READ();
-
-        delete[] iov;
+        m_stats.record(IO_OP_READ, amount, !m_map, start);
 
         return 1;
     }
 
     int raw_write(const byte *buffer, off_t amount, off_t offset) {
-        if (!verify_io_parms(amount, offset)) {
+        if (m_read_only || !verify_io_parms(amount, offset)) {
             return 0;
         }
 
+        auto start = IOStats::now();
+
         if (pwrite(m_fd, buffer, amount, offset) != amount) {
             return 0;
         }
 
-        INC_WRITE();
+        m_stats.record(IO_OP_WRITE, amount, 1, start);
 
         return 1;
     }
 
-    int raw_allocate(size_t amount) {
-        if (!m_file_open || (amount % SECTOR_SIZE != 0)) {
-            return 0;
+    /*
+     * Ensure that the backing file extends to at least end bytes, and then
+     * make the space up to end visible to readers. Any number of threads
+     * may call this at once.
+     */
+    int raw_allocate(off_t end) {
+        off_t allocated = m_allocated.load(std::memory_order_acquire);
+        while (allocated < end) {
+            /*
+             * Growing from the current extent, rather than from the start
+             * of the caller's own range, covers any ranges reserved by
+             * other threads that have not yet been allocated. Overlapping
+             * fallocate calls are harmless.
+             */
+            off_t target = std::max<off_t>(end, allocated + (off_t) m_prealloc_pages.load(std::memory_order_relaxed) * m_page_size);
+            if (fallocate(m_fd, 0, allocated, target - allocated)) {
+                return 0;
+            }
+
+            if (m_allocated.compare_exchange_weak(allocated, target, std::memory_order_acq_rel)) {
+                break;
+            }
         }
 
-        int alloc_mode = 0;
-        if (fallocate(m_fd, alloc_mode, m_size, amount)) {
-            return 0;
+        off_t size = m_size.load(std::memory_order_relaxed);
+        while (size < end && !m_size.compare_exchange_weak(size, end, std::memory_order_release))
+            ;
+
+        return 1;
+    }
+
+    /*
+     * Ensure that cnt more operations can be queued on the ring without
+     * exceeding its capacity, reaping completions to make room if
+     * necessary. Returns false if this is not possible.
+     */
+    bool reserve_async_slots(size_t cnt) {
+        if (!m_ring || cnt > m_ring->capacity()) {
+            return false;
+        }
+
+        while (m_async_outstanding + cnt > m_ring->capacity()) {
+            if (submit_async() < 0 || !reap_async_completions(true)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*
+     * Process all available completions from the ring, and update the state
+     * of their associated requests. If wait is true, blocks until at least
+     * one completion is available. Returns false if wait is true and no
+     * completion could be reaped.
+     */
+    bool reap_async_completions(bool wait) {
+        uint64_t tok;
+        int32_t res;
+        bool reaped = false;
+
+        while (m_ring->reap(&tok, &res, wait && !reaped)) {
+            reaped = true;
+            m_async_outstanding--;
+
+            auto itr = m_async_reqs.find(tok);
+            if (itr == m_async_reqs.end()) {
+                continue;
+            }
+
+            if (res < 0) {
+                itr->second.failed = true;
+            } else {
+                itr->second.completed += res;
+            }
+
+            auto &req = itr->second;
+            if (--req.pending == 0 && !req.failed) {
+                if (m_checksums && req.type == IO_OP_READ && req.completed == req.expected && !verify_async_read(req)) {
+                    req.failed = true;
+                } else {
+                    m_stats.record(req.type, req.completed, 0, req.start);
+                }
+            }
+        }
+
+        return reaped || !wait;
+    }
+
+    bool verify_async_read(const async_request &req) {
+        if (req.pnums.size() > 0) {
+            for (size_t i=0; i<req.pnums.size(); i++) {
+                if (!verify_page(req.pnums[i], (const byte *) req.iov[i].iov_base)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        return verify_pages(req.first_pnum, req.expected / m_page_size, req.buffer);
+    }
+
+    uint32_t page_checksum(const byte *page) const {
+        return crc32c(page, m_page_size - sizeof(PageTrailer::checksum));
+    }
+
+    void stamp_page(PageNum pnum, byte *page) const {
+        byte *trailer = page + m_page_size - sizeof(PageTrailer);
+        memcpy(trailer + offsetof(PageTrailer, pnum), &pnum, sizeof(pnum));
+
+        uint32_t checksum = page_checksum(page);
+        memcpy(trailer + offsetof(PageTrailer, checksum), &checksum, sizeof(checksum));
+    }
+
+    /*
+     * Write page_cnt contiguous pages starting at first_page. If checksums
+     * are enabled, the pages are copied in batches into a scratch buffer and
+     * stamped, rather than being written directly from the caller's buffer.
+     */
+    int write_stamped(PageNum first_page, size_t page_cnt, const byte *buffer) {
+        if (!m_checksums) {
+            return raw_write(buffer, page_cnt * m_page_size, pnum_to_offset(first_page, m_page_size));
+        }
+
+        size_t batch = std::min(page_cnt, CHECKSUM_WRITE_BATCH);
+        std::unique_ptr<byte, buffer_deleter> scratch(sf_aligned_alloc(SECTOR_SIZE, batch * m_page_size));
+
+        for (size_t i=0; i<page_cnt; i+=batch) {
+            size_t cnt = std::min(batch, page_cnt - i);
+            memcpy(scratch.get(), buffer + i * m_page_size, cnt * m_page_size);
+            for (size_t j=0; j<cnt; j++) {
+                stamp_page(first_page + i + j, get_page(scratch.get(), j, m_page_size));
+            }
+
+            if (!raw_write(scratch.get(), cnt * m_page_size, pnum_to_offset(first_page + i, m_page_size))) {
+                return 0;
+            }
         }
 
-        m_size += amount;
         return 1;
+    }
+
+    int submit_async() {
+        int res = m_ring->submit();
+        if (res > 0) {
+            m_stats.record_async_submit();
+        }
+
+        return res;
+    }
+
+    IOStatus release_async_request(std::unordered_map<IOToken, async_request>::iterator itr) {
+        bool success = !itr->second.failed && itr->second.completed == itr->second.expected;
+        m_async_reqs.erase(itr);
+
+        return success ? IO_SUCCESS : IO_FAILED;
+    }
 
+    void drain_async_requests() {
+        if (!m_ring) {
+            return;
+        }
+
+        submit_async();
+        while (m_async_outstanding > 0 && reap_async_completions(true))
+            ;
+
+        m_async_reqs.clear();
     }
 
     bool verify_io_parms(off_t amount, off_t offset) {
-        if (!m_file_open || amount + offset > m_size) {
+        if (!m_file_open || amount + offset > get_file_size()) {
             return false;
         }
 
@@ -379,13 +1162,34 @@ private:
 
     int m_fd;
     bool m_file_open;
-    off_t m_size;
+
+    /*
+     * The number of bytes visible to readers, the number reserved by
+     * allocate_pages, and the number allocated in the backing file,
+     * respectively. m_size <= m_reserved, and m_size <= m_allocated.
+     */
+    std::atomic<off_t> m_size;
+    std::atomic<off_t> m_reserved;
+    std::atomic<off_t> m_allocated;
+    std::atomic<PageNum> m_prealloc_pages;
+
     mode_t m_mode;
     std::string m_fname;
     int m_flags;
+    size_t m_page_size;
+
+    byte *m_map;
+    bool m_read_only;
+    bool m_checksums;
+
+    IOVecArena m_read_arena;
+
+    IOStats m_stats;
 
-    size_t m_read_cnt;
-    size_t m_write_cnt;
+    std::unique_ptr<IOUring> m_ring;
+    std::unordered_map<IOToken, async_request> m_async_reqs;
+    IOToken m_next_token;
+    size_t m_async_outstanding;
 };
 
 }
@@ -1,56 +1,160 @@
+#pragma once
+
 #include <memory>
+#include <vector>
+#include <algorithm>
 
 #include "psu-util/alignment.h"
 #include "psu-io/PagedFile.h"
 
 namespace psudb {
-std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum);
+std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum, size_t, size_t);
 
 class PagedFileIterator {
-    friend std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum);
+    friend std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *, PageNum, PageNum, size_t, size_t);
 
 public:
     bool next() {
-        while (m_current_pnum < m_stop_pnum) {
-            if (m_pfile->read_page(++m_current_pnum, m_buffer)) {
-                return true;
+        if (m_started && m_slot_pos + 1 < m_slots[m_cur_slot].page_cnt) {
+            m_slot_pos++;
+            m_current_pnum++;
+            return true;
+        }
+
+        if (!m_started) {
+            /* fill the entire read-ahead window */
+            for (size_t i=0; i<m_slots.size(); i++) {
+                issue_batch(i);
             }
-            
+
+            m_started = true;
+        } else {
+            /*
+             * The current batch has been fully consumed, so its buffer can be
+             * reused for the next batch in the scan.
+             */
+            issue_batch(m_cur_slot);
+            m_cur_slot = (m_cur_slot + 1) % m_slots.size();
+        }
+
+        if (m_slots[m_cur_slot].page_cnt == 0) {
+            /* no more pages to read */
+            return false;
+        }
+
+        if (!complete_batch(m_cur_slot)) {
             /* IO error of some kind */
+            m_slots[m_cur_slot].page_cnt = 0;
             return false;
         }
 
-        /* no more pages to read */
-        return false;
+        m_slot_pos = 0;
+        m_current_pnum = m_slots[m_cur_slot].first_pnum;
+        return true;
     }
 
     byte *get_item() {
-        return m_buffer;
+        return get_page(m_slots[m_cur_slot].buffer, m_slot_pos, m_page_size);
     }
 
     ~PagedFileIterator() {
+        /* in-flight reads must finish before their buffers are released */
+        for (auto &slot : m_slots) {
+            if (slot.token != INVALID_IOTOKEN) {
+                m_pfile->async_wait(slot.token);
+            }
+        }
+
         free(m_buffer);
     }
 
 private:
+    struct batch_slot {
+        byte *buffer;
+        PageNum first_pnum;
+        size_t page_cnt;
+        IOToken token;
+    };
+
     PagedFile *m_pfile;
+    size_t m_page_size;
     PageNum m_current_pnum;
     PageNum m_start_pnum;
     PageNum m_stop_pnum;
 
+    PageNum m_next_pnum;
+    size_t m_batch_size;
+    std::vector<batch_slot> m_slots;
+    size_t m_cur_slot;
+    size_t m_slot_pos;
+    bool m_started;
+
     byte *m_buffer;
 
-    PagedFileIterator(PagedFile *pfile, PageNum start_page, PageNum stop_page)
+    PagedFileIterator(PagedFile *pfile, PageNum start_page, PageNum stop_page, size_t batch_size, size_t batch_cnt)
       : m_pfile(pfile)
+      , m_page_size(pfile->get_page_size())
       , m_current_pnum((start_page == INVALID_PNUM) ? 0 : start_page - 1)
       , m_start_pnum(start_page)
       , m_stop_pnum(stop_page)
-      , m_buffer((byte *)aligned_alloc(SECTOR_SIZE, PAGE_SIZE)) {}
+      , m_next_pnum(m_current_pnum + 1)
+      , m_batch_size(std::max<size_t>(batch_size, 1))
+      , m_cur_slot(0)
+      , m_slot_pos(0)
+      , m_started(false) {
+
+        /*
+         * Without async IO, batches are read one at a time as they are
+         * reached, and so there is no point in keeping more than one.
+         */
+        size_t slot_cnt = (pfile->supports_async_io()) ? std::max<size_t>(batch_cnt, 1) : 1;
+        m_buffer = sf_aligned_alloc(SECTOR_SIZE, slot_cnt * m_batch_size * m_page_size);
+
+        m_slots.resize(slot_cnt);
+        for (size_t i=0; i<slot_cnt; i++) {
+            m_slots[i] = {get_page(m_buffer, i * m_batch_size, m_page_size), INVALID_PNUM, 0, INVALID_IOTOKEN};
+        }
+    }
+
+    /*
+     * Assign the next batch of pages in the scan to a slot. If async IO is
+     * available, the read is started immediately; otherwise it is deferred
+     * until complete_batch is called.
+     */
+    void issue_batch(size_t idx) {
+        auto &slot = m_slots[idx];
+
+        if (m_next_pnum > m_stop_pnum) {
+            slot.page_cnt = 0;
+            return;
+        }
+
+        slot.first_pnum = m_next_pnum;
+        slot.page_cnt = std::min<size_t>(m_batch_size, m_stop_pnum - m_next_pnum + 1);
+        m_next_pnum += slot.page_cnt;
+
+        if (m_pfile->supports_async_io()) {
+            slot.token = m_pfile->async_read_pages(slot.first_pnum, slot.page_cnt, slot.buffer);
+            m_pfile->async_submit();
+        }
+    }
+
+    bool complete_batch(size_t idx) {
+        auto &slot = m_slots[idx];
+
+        if (slot.token != INVALID_IOTOKEN) {
+            auto status = m_pfile->async_wait(slot.token);
+            slot.token = INVALID_IOTOKEN;
+            return status == IO_SUCCESS;
+        }
+
+        return m_pfile->read_pages(slot.first_pnum, slot.page_cnt, slot.buffer);
+    }
 };
 
 
-std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *pfile, PageNum start_page=0, PageNum stop_page=0) {
-    auto itr = new PagedFileIterator(pfile, start_page, stop_page);
+std::unique_ptr<PagedFileIterator> create_pagedfile_itr(PagedFile *pfile, PageNum start_page=0, PageNum stop_page=0, size_t batch_size=1, size_t batch_cnt=2) {
+    auto itr = new PagedFileIterator(pfile, start_page, stop_page, batch_size, batch_cnt);
     return std::unique_ptr<PagedFileIterator>(itr);
 }
 }
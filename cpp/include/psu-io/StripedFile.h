@@ -0,0 +1,542 @@
+/*
+ * include/psu-io/StripedFile.h
+ *
+ * Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Modified BSD License.
+ *
+ * A paged file striped across several backing PagedFiles, typically each
+ * on its own device. The striped file presents a single PageNum address
+ * space, with the same interface as PagedFile. Logical pages are assigned
+ * to the backing files round-robin, in stripes of stripe_pages pages; a
+ * stripe of 1 interleaves individual pages, while a larger stripe places
+ * contiguous extents on each file.
+ *
+ * Multi-page reads and writes are split into one request per backing file,
+ * and the devices are used in parallel. Asynchronous IO is enabled when the
+ * file is created, if it is supported, and every file's request is then
+ * issued before any is waited upon. Otherwise, each file's request is made
+ * synchronously, on its own thread.
+ *
+ * Concurrency: as with PagedFile, asynchronous IO is not thread-safe, and so
+ * while it is enabled, multi-page reads and writes must not be made from
+ * several threads at once. Callers that need to do so should first call
+ * disable_async_io.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <span>
+#include <climits>
+#include <algorithm>
+
+#include "psu-util/alignment.h"
+#include "psu-util/parallel.h"
+#include "psu-io/IOTypes.h"
+#include "psu-io/IOStats.h"
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+
+namespace psudb {
+
+class StripedFileIterator;
+
+class StripedFile {
+public:
+    /*
+     * Open (or create) a striped file backed by the files named in fnames.
+     * An existing striped file must be opened with the same files, in the
+     * same order, and with the same stripe size with which it was created.
+     * Returns nullptr if any of the files cannot be opened, or if their
+     * sizes are inconsistent with the requested layout. Asynchronous IO is
+     * enabled on the files if it is supported.
+     */
+    static std::unique_ptr<StripedFile> create(const std::vector<std::string> &fnames, bool new_file=true, bool o_direct=true,
+                                               PageNum stripe_pages=1, size_t page_size=PAGE_SIZE) {
+        if (fnames.size() == 0 || stripe_pages == 0) {
+            return nullptr;
+        }
+
+        std::vector<std::unique_ptr<PagedFile>> files;
+        size_t page_cnt = 0;
+        for (auto &fname : fnames) {
+            auto pfile = PagedFile::create(fname, new_file, o_direct, page_size);
+            if (!pfile) {
+                return nullptr;
+            }
+
+            page_cnt += pfile->get_page_count();
+            files.push_back(std::move(pfile));
+        }
+
+        auto sfile = std::unique_ptr<StripedFile>(new StripedFile(std::move(files), stripe_pages, page_cnt));
+        for (size_t i=0; i<sfile->m_files.size(); i++) {
+            if (sfile->m_files[i]->get_page_count() != sfile->local_page_count(i, page_cnt)) {
+                return nullptr;
+            }
+        }
+
+        sfile->enable_async_io();
+        return sfile;
+    }
+
+    /*
+     * Add count new pages to the file, and return the PageNum of the first.
+     * Each backing file is grown by its share of the new pages. Returns
+     * INVALID_PNUM on failure.
+     */
+    PageNum allocate_pages(PageNum count=1) {
+        if (count == 0) {
+            return INVALID_PNUM;
+        }
+
+        std::unique_lock<std::mutex> lock(m_alloc_mutex);
+
+        PageNum first = get_page_count() + 1;
+        PageNum total = get_page_count() + count;
+
+        for (size_t i=0; i<m_files.size(); i++) {
+            PageNum needed = local_page_count(i, total);
+            PageNum have = m_files[i]->get_page_count();
+            if (needed > have && m_files[i]->allocate_pages(needed - have) == INVALID_PNUM) {
+                return INVALID_PNUM;
+            }
+        }
+
+        m_page_cnt.store(total, std::memory_order_release);
+        return first;
+    }
+
+    int read_page(PageNum pnum, byte *buffer_ptr) {
+        if (!check_pnum(pnum)) {
+            return 0;
+        }
+
+        auto loc = locate(pnum);
+        return m_files[loc.file]->read_page(loc.pnum, buffer_ptr);
+    }
+
+    /*
+     * Reads several pages stored contiguously into a single buffer, which
+     * must be SECTOR_SIZE aligned and at least page_cnt * get_page_size()
+     * bytes large.
+     */
+    int read_pages(PageNum first_page, size_t page_cnt, byte *buffer_ptr) {
+        if (page_cnt == 0 || !check_pnum(first_page) || !check_pnum(first_page + page_cnt - 1)) {
+            return 0;
+        }
+
+        auto per_file = split(first_page, page_cnt, buffer_ptr);
+        return read_split(per_file);
+    }
+
+    /*
+     * Reads several pages into associated buffers, each of which must be
+     * SECTOR_SIZE aligned and at least get_page_size() bytes large.
+     */
+    int read_pages(std::span<std::pair<PageNum, byte*>> pages) {
+        std::vector<std::vector<std::pair<PageNum, byte*>>> per_file(m_files.size());
+        for (auto &pg : pages) {
+            if (!check_pnum(pg.first)) {
+                return 0;
+            }
+
+            auto loc = locate(pg.first);
+            per_file[loc.file].push_back({loc.pnum, pg.second});
+        }
+
+        return read_split(per_file);
+    }
+
+    int write_page(PageNum pnum, const byte *buffer_ptr) {
+        if (!check_pnum(pnum)) {
+            return 0;
+        }
+
+        auto loc = locate(pnum);
+        return m_files[loc.file]->write_page(loc.pnum, buffer_ptr);
+    }
+
+    /*
+     * Writes multiple pages stored sequentially in the provided buffer into
+     * a contiguous region of the file, starting at first_page. Each stripe
+     * is written to its backing file using a single IO.
+     */
+    int write_pages(PageNum first_page, size_t page_cnt, const byte *buffer_ptr) {
+        if (page_cnt == 0 || !check_pnum(first_page) || !check_pnum(first_page + page_cnt - 1)) {
+            return 0;
+        }
+
+        std::vector<std::vector<stripe_write>> per_file(m_files.size());
+        for (size_t i=0; i<page_cnt; ) {
+            /* the pages remaining in the stripe containing this one */
+            PageNum pnum = first_page + i;
+            size_t cnt = std::min<size_t>(m_stripe_pages - (pnum - 1) % m_stripe_pages, page_cnt - i);
+
+            auto loc = locate(pnum);
+            per_file[loc.file].push_back({loc.pnum, cnt, buffer_ptr + i * get_page_size()});
+
+            i += cnt;
+        }
+
+        if (!m_async) {
+            return for_each_file(per_file, [&](size_t i) {
+                int success = 1;
+                for (auto &w : per_file[i]) {
+                    success &= m_files[i]->write_pages(w.pnum, w.cnt, w.src);
+                }
+
+                return success;
+            });
+        }
+
+        std::vector<std::pair<PagedFile *, IOToken>> tokens;
+        int success = 1;
+
+        for (size_t i=0; i<m_files.size(); i++) {
+            auto &pfile = m_files[i];
+            for (auto &w : per_file[i]) {
+                IOToken tok = pfile->async_write_pages(w.pnum, w.cnt, w.src);
+                if (tok != INVALID_IOTOKEN) {
+                    tokens.push_back({pfile.get(), tok});
+                } else {
+                    success &= pfile->write_pages(w.pnum, w.cnt, w.src);
+                }
+            }
+
+            if (per_file[i].size() > 0) {
+                pfile->async_submit();
+            }
+        }
+
+        return wait_all(tokens) && success;
+    }
+
+    /*
+     * Enable asynchronous IO on every backing file, so that multi-page
+     * reads and writes to all of the files are issued from the calling
+     * thread. This is done by create, and so need only be called again
+     * after disable_async_io. Returns 1 on success, and 0 if asynchronous
+     * IO is not supported.
+     */
+    int enable_async_io(unsigned depth=64) {
+        for (auto &pfile : m_files) {
+            if (!pfile->enable_async_io(depth)) {
+                return 0;
+            }
+        }
+
+        m_async = true;
+        return 1;
+    }
+
+    /*
+     * Make multi-page reads and writes synchronously, with one thread per
+     * backing file involved, rather than using asynchronous IO.
+     */
+    void disable_async_io() {
+        m_async = false;
+    }
+
+    /*
+     * Returns true if multi-page reads and writes use asynchronous IO.
+     */
+    bool supports_async_io() const {
+        return m_async;
+    }
+
+    /*
+     * Returns an iterator over the pages in the range [start_page, end_page].
+     * If end_page is INVALID_PNUM, the scan will run to the end of the file.
+     * Pages are read in batches of batch_size pages, each of which is read
+     * from all of the backing files in parallel; batch_size should be a
+     * multiple of get_stripe_width() for
+     * the scan to make use of every device. Returns nullptr if the range
+     * is invalid.
+     */
+    std::unique_ptr<StripedFileIterator> start_scan(PageNum start_page=1, PageNum end_page=0, size_t batch_size=1);
+
+    /*
+     * Returns the number of allocated pages in the file.
+     */
+    PageNum get_page_count() const {
+        return m_page_cnt.load(std::memory_order_acquire);
+    }
+
+    size_t get_page_size() const {
+        return m_files[0]->get_page_size();
+    }
+
+    /*
+     * Returns the number of pages in a single stripe.
+     */
+    PageNum get_stripe_pages() const {
+        return m_stripe_pages;
+    }
+
+    /*
+     * Returns the number of pages in a full stripe across every backing
+     * file.
+     */
+    size_t get_stripe_width() const {
+        return m_stripe_pages * m_files.size();
+    }
+
+    size_t get_file_count() const {
+        return m_files.size();
+    }
+
+    /*
+     * Returns the idx'th backing file.
+     */
+    PagedFile *get_file(size_t idx) {
+        return m_files[idx].get();
+    }
+
+    /*
+     * Returns the combined IO statistics of the backing files.
+     */
+    IOStatsSnapshot get_stats() {
+        IOStatsSnapshot total;
+        for (auto &pfile : m_files) {
+            total += pfile->get_stats().snapshot();
+        }
+
+        return total;
+    }
+
+    /*
+     * Delete all of the backing files. Returns 1 if every file is
+     * removed, and 0 otherwise.
+     */
+    int remove_files() {
+        int success = 1;
+        for (auto &pfile : m_files) {
+            success &= pfile->remove_file();
+        }
+
+        return success;
+    }
+
+private:
+    struct location {
+        size_t file;
+        PageNum pnum;
+    };
+
+    /*
+     * A run of cnt pages, within a single stripe, to be written to a
+     * backing file.
+     */
+    struct stripe_write {
+        PageNum pnum;
+        size_t cnt;
+        const byte *src;
+    };
+
+    std::vector<std::unique_ptr<PagedFile>> m_files;
+    PageNum m_stripe_pages;
+    std::atomic<PageNum> m_page_cnt;
+    std::mutex m_alloc_mutex;
+    bool m_async;
+
+    StripedFile(std::vector<std::unique_ptr<PagedFile>> files, PageNum stripe_pages, PageNum page_cnt)
+      : m_files(std::move(files)), m_stripe_pages(stripe_pages), m_page_cnt(page_cnt), m_async(false) {}
+
+    bool check_pnum(PageNum pnum) const {
+        return pnum != INVALID_PNUM && pnum <= get_page_count();
+    }
+
+    /*
+     * Map a logical page to its backing file, and its page within it.
+     */
+    location locate(PageNum pnum) const {
+        size_t idx = pnum - 1;
+        size_t stripe = idx / m_stripe_pages;
+
+        return {stripe % m_files.size(), (PageNum) ((stripe / m_files.size()) * m_stripe_pages + idx % m_stripe_pages + 1)};
+    }
+
+    /*
+     * Returns the number of pages that the idx'th file must contain to
+     * hold its share of a file of page_cnt logical pages.
+     */
+    PageNum local_page_count(size_t idx, PageNum page_cnt) const {
+        size_t full_stripes = page_cnt / m_stripe_pages;
+        size_t partial = page_cnt % m_stripe_pages;
+        size_t n = m_files.size();
+
+        size_t cnt = (full_stripes / n) * m_stripe_pages;
+        if (idx < full_stripes % n) {
+            cnt += m_stripe_pages;
+        } else if (idx == full_stripes % n) {
+            cnt += partial;
+        }
+
+        return cnt;
+    }
+
+    std::vector<std::vector<std::pair<PageNum, byte*>>> split(PageNum first_page, size_t page_cnt, byte *buffer) const {
+        std::vector<std::vector<std::pair<PageNum, byte*>>> per_file(m_files.size());
+        for (size_t i=0; i<page_cnt; i++) {
+            auto loc = locate(first_page + i);
+            per_file[loc.file].push_back({loc.pnum, get_page(buffer, i, get_page_size())});
+        }
+
+        return per_file;
+    }
+
+    /*
+     * Read each file's share of a request. If async IO is enabled, every
+     * file's read is issued before any is waited upon, and otherwise each
+     * file is read on its own thread. Each request is limited to IOV_MAX
+     * pages, as it is issued as vectored reads.
+     */
+    int read_split(std::vector<std::vector<std::pair<PageNum, byte*>>> &per_file) {
+        if (!m_async) {
+            return for_each_file(per_file, [&](size_t i) {
+                auto &pages = per_file[i];
+                int success = 1;
+                for (size_t j=0; j<pages.size(); j+=IOV_MAX) {
+                    size_t cnt = std::min<size_t>(IOV_MAX, pages.size() - j);
+                    success &= m_files[i]->read_pages(std::span<std::pair<PageNum, byte*>>(pages.data() + j, cnt));
+                }
+
+                return success;
+            });
+        }
+
+        std::vector<std::pair<PagedFile *, IOToken>> tokens;
+        int success = 1;
+
+        for (size_t i=0; i<m_files.size(); i++) {
+            auto &pages = per_file[i];
+            auto &pfile = m_files[i];
+
+            for (size_t j=0; j<pages.size(); j+=IOV_MAX) {
+                size_t cnt = std::min<size_t>(IOV_MAX, pages.size() - j);
+                std::span<std::pair<PageNum, byte*>> part(pages.data() + j, cnt);
+
+                IOToken tok = pfile->async_read_pages(std::vector<std::pair<PageNum, byte*>>(part.begin(), part.end()));
+                if (tok != INVALID_IOTOKEN) {
+                    tokens.push_back({pfile.get(), tok});
+                } else {
+                    success &= pfile->read_pages(part);
+                }
+            }
+
+            if (pages.size() > 0) {
+                pfile->async_submit();
+            }
+        }
+
+        return wait_all(tokens) && success;
+    }
+
+    /*
+     * Call f(i) for each backing file i with a non-empty share of
+     * per_file, each on its own thread if there is more than one. Returns
+     * 1 if every call returns 1, and 0 otherwise.
+     */
+    template <typename T, typename F>
+    int for_each_file(const std::vector<std::vector<T>> &per_file, F &&f) {
+        std::vector<size_t> active;
+        for (size_t i=0; i<per_file.size(); i++) {
+            if (per_file[i].size() > 0) {
+                active.push_back(i);
+            }
+        }
+
+        std::vector<int> results(active.size(), 1);
+        parallel_for(active.size(), active.size(), [&](size_t start, size_t stop) {
+            for (size_t j=start; j<stop; j++) {
+                results[j] = f(active[j]);
+            }
+        });
+
+        return std::find(results.begin(), results.end(), 0) == results.end();
+    }
+
+    int wait_all(std::vector<std::pair<PagedFile *, IOToken>> &tokens) {
+        int success = 1;
+        for (auto &tok : tokens) {
+            success &= tok.first->async_wait(tok.second) == IO_SUCCESS;
+        }
+
+        return success;
+    }
+};
+
+
+class StripedFileIterator {
+    friend class StripedFile;
+
+public:
+    bool next() {
+        if (m_pos + 1 < m_batch_cnt) {
+            m_pos++;
+            return true;
+        }
+
+        if (m_next_pnum > m_stop_pnum) {
+            return false;
+        }
+
+        m_batch_cnt = std::min<size_t>(m_batch_size, m_stop_pnum - m_next_pnum + 1);
+        if (!m_sfile->read_pages(m_next_pnum, m_batch_cnt, m_buffer)) {
+            /* IO error of some kind */
+            m_batch_cnt = 0;
+            m_next_pnum = m_stop_pnum + 1;
+            return false;
+        }
+
+        m_next_pnum += m_batch_cnt;
+        m_pos = 0;
+        return true;
+    }
+
+    byte *get_item() {
+        return get_page(m_buffer, m_pos, m_sfile->get_page_size());
+    }
+
+    ~StripedFileIterator() {
+        free(m_buffer);
+    }
+
+private:
+    StripedFile *m_sfile;
+    PageNum m_next_pnum;
+    PageNum m_stop_pnum;
+    size_t m_batch_size;
+    size_t m_batch_cnt;
+    size_t m_pos;
+    byte *m_buffer;
+
+    StripedFileIterator(StripedFile *sfile, PageNum start_page, PageNum stop_page, size_t batch_size)
+      : m_sfile(sfile)
+      , m_next_pnum(start_page)
+      , m_stop_pnum(stop_page)
+      , m_batch_size(std::max<size_t>(batch_size, 1))
+      , m_batch_cnt(0)
+      , m_pos(0)
+      , m_buffer(sf_aligned_alloc(SECTOR_SIZE, m_batch_size * sfile->get_page_size())) {}
+};
+
+
+inline std::unique_ptr<StripedFileIterator> StripedFile::start_scan(PageNum start_page, PageNum end_page, size_t batch_size) {
+    if (end_page == INVALID_PNUM) {
+        end_page = get_page_count();
+    }
+
+    if (check_pnum(start_page) && check_pnum(end_page)) {
+        return std::unique_ptr<StripedFileIterator>(new StripedFileIterator(this, start_page, end_page, batch_size));
+    }
+
+    return nullptr;
+}
+
+}
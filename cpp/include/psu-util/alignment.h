@@ -27,7 +27,8 @@ const size_t SECTOR_SIZE = 512;
 
 /*
  * The standard sized block of data (in bytes) for use in IO 
- * operations.
+ * operations. This is the default; PagedFile supports other
+ * page sizes on a per-file basis.
  */
 const size_t PAGE_SIZE = 4096;
 
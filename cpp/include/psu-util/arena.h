@@ -0,0 +1,219 @@
+/*
+ * include/psu-util/arena.h
+ *
+ * Copyright (C) 2023 Douglas Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Revised BSD License.
+ *
+ * A pool of large, page-aligned memory regions (arenas) obtained directly
+ * from mmap, optionally backed by huge pages. Released arenas are cached
+ * and handed out again for later requests of a similar size, so that a
+ * data structure which is repeatedly built and torn down (such as the
+ * levels of a BentleySaxe) does not pay for mapping, faulting in and
+ * unmapping fresh memory each time.
+ */
+#pragma once
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "psu-util/alignment.h"
+
+namespace psudb {
+
+/*
+ * The size of a (2 MiB) huge page on x86-64 and most ARM64 systems.
+ */
+const size_t HUGE_PAGE_SIZE = 1ul << 21;
+
+enum class HugePages {
+    NONE,        /* regular pages only */
+    TRANSPARENT, /* ask for transparent huge pages with madvise(MADV_HUGEPAGE) */
+    EXPLICIT     /* use reserved huge pages (MAP_HUGETLB), or THP if none are available */
+};
+
+class ArenaPool {
+public:
+    /*
+     * Create a pool that backs its arenas using the given kind of huge
+     * pages, and which caches at most max_cached_bytes of released arenas
+     * for reuse.
+     */
+    ArenaPool(HugePages huge_pages=HugePages::TRANSPARENT, size_t max_cached_bytes=1ul << 30)
+        : m_huge_pages(huge_pages), m_max_cached_bytes(max_cached_bytes), m_cached_bytes(0)
+        , m_map_cnt(0), m_reuse_cnt(0) {}
+
+    /*
+     * Unmaps all cached arenas. Every arena allocated from the pool must
+     * have been released before it is destroyed.
+     */
+    ~ArenaPool() {
+        trim();
+    }
+
+    /*
+     * Returns a page-aligned arena of at least size bytes, or nullptr if
+     * the memory could not be mapped. A cached arena is reused if one of
+     * sufficient size (but no more than twice the needed size) is
+     * available. The contents of a reused arena are not zeroed.
+     */
+    byte *allocate(size_t size) {
+        size = arena_size(size);
+
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            auto itr = m_free.lower_bound(size);
+            if (itr != m_free.end() && itr->first <= 2 * size) {
+                byte *arena = itr->second;
+                m_live[arena] = itr->first;
+                m_cached_bytes -= itr->first;
+                m_free.erase(itr);
+                m_reuse_cnt++;
+
+                return arena;
+            }
+        }
+
+        byte *arena = map_arena(size);
+        if (arena) {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_live[arena] = size;
+            m_map_cnt++;
+        }
+
+        return arena;
+    }
+
+    /*
+     * Return an arena, allocated from this pool, to it. The arena is cached
+     * for reuse if there is room, and otherwise unmapped.
+     */
+    void release(byte *arena) {
+        if (arena == nullptr) {
+            return;
+        }
+
+        size_t size;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            auto itr = m_live.find(arena);
+            if (itr == m_live.end()) {
+                return;
+            }
+
+            size = itr->second;
+            m_live.erase(itr);
+
+            if (m_cached_bytes + size <= m_max_cached_bytes) {
+                m_free.insert({size, arena});
+                m_cached_bytes += size;
+                return;
+            }
+        }
+
+        munmap(arena, size);
+    }
+
+    /*
+     * Unmap all of the cached arenas.
+     */
+    void trim() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        for (auto &[size, arena] : m_free) {
+            munmap(arena, size);
+        }
+
+        m_free.clear();
+        m_cached_bytes = 0;
+    }
+
+    /*
+     * Returns the size of the arena that will be used for an allocation
+     * of size bytes. Arenas backed by huge pages are a multiple of the
+     * huge page size.
+     */
+    size_t arena_size(size_t size) {
+        return TYPEALIGN((m_huge_pages == HugePages::NONE) ? PAGE_SIZE : HUGE_PAGE_SIZE, std::max<size_t>(size, 1));
+    }
+
+    size_t get_cached_bytes() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        return m_cached_bytes;
+    }
+
+    /*
+     * Returns the number of arenas that have been newly mapped, and the
+     * number of allocations satisfied by reusing a cached arena.
+     */
+    size_t get_map_count() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        return m_map_cnt;
+    }
+
+    size_t get_reuse_count() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        return m_reuse_cnt;
+    }
+
+    HugePages get_huge_pages() {
+        return m_huge_pages;
+    }
+
+private:
+    HugePages m_huge_pages;
+    size_t m_max_cached_bytes;
+
+    std::mutex m_lock;
+    std::multimap<size_t, byte *> m_free;
+    std::unordered_map<byte *, size_t> m_live;
+    size_t m_cached_bytes;
+    size_t m_map_cnt;
+    size_t m_reuse_cnt;
+
+    byte *map_arena(size_t size) {
+        if (m_huge_pages == HugePages::EXPLICIT) {
+            void *arena = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (arena != MAP_FAILED) {
+                return (byte *) arena;
+            }
+        }
+
+        if (m_huge_pages == HugePages::NONE) {
+            void *arena = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return (arena == MAP_FAILED) ? nullptr : (byte *) arena;
+        }
+
+        /*
+         * Transparent huge pages can only back huge page aligned memory, so
+         * over-allocate by a huge page, and unmap the unaligned ends.
+         */
+        void *region = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            return nullptr;
+        }
+
+        byte *start = (byte *) region;
+        byte *arena = (byte *) TYPEALIGN(HUGE_PAGE_SIZE, (size_t) start);
+        if (arena > start) {
+            munmap(start, arena - start);
+        }
+
+        byte *stop = start + size + HUGE_PAGE_SIZE;
+        if (stop > arena + size) {
+            munmap(arena + size, stop - (arena + size));
+        }
+
+#ifdef MADV_HUGEPAGE
+        madvise(arena, size, MADV_HUGEPAGE);
+#endif
+
+        return arena;
+    }
+};
+
+}
@@ -8,6 +8,15 @@
  * The data structure being used must support the BentleyInterface interface
  * described in this file. This condition is enforced using concepts.
  *
+ * BentleySaxe performs all reconstructions synchronously, within insert.
+ * By default it uses the binary decomposition of [1], but it can also lay
+ * out its levels like an LSM-tree, using leveling or tiering with a
+ * configurable scale factor, trading rebuild cost against the number of
+ * structures probed by each query.
+ * ConcurrentBentleySaxe instead absorbs inserts into a small buffer, and
+ * merges levels on a background thread, keeping the old levels queryable
+ * until the merged one replaces them.
+ *
  * For more information see,
  *
  * [1] https://jeffe.cs.illinois.edu/teaching/datastructures/notes/01-statictodynamic.pdf
@@ -18,9 +27,17 @@
 #pragma once
 
 #include <vector>
+#include <span>
+#include <deque>
+#include <algorithm>
+#include <iterator>
 #include <concepts>
 #include <cassert>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 namespace psudb { namespace bsm {
 
@@ -33,6 +50,51 @@ concept BentleyInterface = requires(DS ds, R rec, void *q, std::vector<R> recset
     {ds.record_count()} -> std::convertible_to<size_t>;
 };
 
+/*
+ * ConcurrentBentleySaxe copies the records out of levels that are still
+ * being queried, rather than unbuilding them, and so also requires
+ * positional access to a structure's records.
+ */
+template <typename DS, typename R>
+concept ConcurrentBentleyInterface = BentleyInterface<DS, R> && requires(DS ds, size_t idx) {
+    {ds.get_record_at(idx)} -> std::convertible_to<const R*>;
+};
+
+/*
+ * Data structures that can also be built directly from several sorted runs
+ * of records (such as the records returned by the unbuild of structures
+ * which keep them in sorted order) are built by merging the runs, rather
+ * than by concatenating and re-sorting them.
+ */
+template <typename DS, typename R>
+concept MergeBuildInterface = BentleyInterface<DS, R> && requires(std::vector<std::vector<R>> runs) {
+    {DS::build_from_runs(runs)} -> std::same_as<DS*>;
+};
+
+/*
+ * Build a new structure from the sorted runs, which are left empty.
+ */
+template <typename R, BentleyInterface<R> DS>
+DS *build_from_sorted_runs(std::vector<std::vector<R>> &runs) {
+    if constexpr (MergeBuildInterface<DS, R>) {
+        return DS::build_from_runs(runs);
+    } else {
+        std::vector<R> S = std::move(runs[0]);
+        for (size_t i=1; i<runs.size(); i++) {
+            S.insert(S.end(), std::make_move_iterator(runs[i].begin()), std::make_move_iterator(runs[i].end()));
+        }
+
+        runs.clear();
+        return DS::build(S);
+    }
+}
+
+enum class LayoutPolicy {
+    BINARY,   /* level i holds 0 or 1 structures of 2^i buffers; an insert merges all full levels */
+    LEVELING, /* level i holds 1 structure of up to scale_factor^(i+1) buffers */
+    TIERING   /* level i holds up to scale_factor structures of scale_factor^i buffers each */
+};
+
 template <typename R, BentleyInterface<R> DS>
 class BentleySaxe {
     typedef std::vector<R> result_set;
@@ -40,73 +102,492 @@ class BentleySaxe {
     typedef std::vector<R> record_set;
 
 public:
-    BentleySaxe() = default;
+    /*
+     * Create a structure that collects inserted records in an unsorted
+     * buffer of buffer_cap records, which is added to the levels, according
+     * to policy, once it is full. With the default capacity of 1, every
+     * insert is immediately built into a level. scale_factor is ignored by
+     * the BINARY policy.
+     */
+    BentleySaxe(size_t buffer_cap=1, LayoutPolicy policy=LayoutPolicy::BINARY, size_t scale_factor=2)
+        : m_buffer_cap(std::max<size_t>(buffer_cap, 1)), m_policy(policy)
+        , m_scale_factor(std::max<size_t>(scale_factor, 2)), m_write_cnt(0) {
+        m_buffer.reserve(m_buffer_cap);
+    }
 
     ~BentleySaxe() {
-        for (size_t i=0; i<m_levels.size(); i++) {
-            delete m_levels[i];
+        for (auto &level : m_levels) {
+            for (auto ds : level) {
+                delete ds;
+            }
+        }
+    }
+
+    void insert(const R &rec) {
+        m_buffer.push_back(rec);
+        if (m_buffer.size() >= m_buffer_cap) {
+            flush_buffer();
         }
     }
 
-    void insert(R &rec) {
-        record_set S = {rec};
+    /*
+     * Insert each of records, as if by insert, filling the buffer a chunk
+     * at a time.
+     */
+    void insert_batch(std::span<const R> records) {
+        while (records.size() > 0) {
+            size_t cnt = std::min(records.size(), m_buffer_cap - m_buffer.size());
+            m_buffer.insert(m_buffer.end(), records.begin(), records.begin() + cnt);
+            records = records.subspan(cnt);
 
-        /* find the first empty level */
-        ssize_t target_idx = -1;
-        for (size_t i=0; i<m_levels.size(); i++) {
-            if (m_levels[i] == nullptr) {
-                target_idx = i;
-                break;
+            if (m_buffer.size() >= m_buffer_cap) {
+                flush_buffer();
             }
+        }
+    }
+
+    result_set query(void *q) {
+        assert(q != nullptr);
 
-            /* deconstruct the level */
-            auto tmp = m_levels[i]->unbuild();
-            delete m_levels[i];
-            m_levels[i] = nullptr;
-            
-            /* union the level's records into the running set */
-            S.insert(S.end(), tmp.begin(), tmp.end());
+        result_set results;
+
+        /* the buffer is unsorted, so build a temporary structure to query it */
+        if (m_buffer.size() > 0) {
+            record_set buffer = m_buffer;
+            std::unique_ptr<DS> buffer_ds(DS::build(buffer));
+
+            auto temp = buffer_ds->query(q);
+            results = buffer_ds->query_merge(results, temp);
         }
 
-        /* 
-         * If we didn't find an empty level, then we
-         * need to grow the structure.
-         */
-        if (target_idx == -1) {
-            m_levels.emplace_back(DS::build(S));
-        } else {
-            m_levels[target_idx] = DS::build(S);
+        for (auto &level : m_levels) {
+            for (auto ds : level) {
+                auto temp = ds->query(q);
+                results = ds->query_merge(results, temp);
+            }
         }
+
+        return results;
     }
 
+    size_t record_count() {
+        size_t total = m_buffer.size();
+        for (auto &level : m_levels) {
+            for (auto ds : level) {
+                total += ds->record_count();
+            }
+        }
+
+        return total;
+    }
+
+    size_t level_count() {
+        return m_levels.size();
+    }
+
+    /*
+     * Returns the number of structures probed by a query, not counting
+     * the buffer.
+     */
+    size_t structure_count() {
+        size_t cnt = 0;
+        for (auto &level : m_levels) {
+            cnt += level.size();
+        }
+
+        return cnt;
+    }
+
+    /*
+     * Returns the number of records in each of the structures on level
+     * idx, or an empty vector if there is no such level.
+     */
+    std::vector<size_t> get_structure_sizes(size_t idx) {
+        std::vector<size_t> sizes;
+        if (idx < m_levels.size()) {
+            for (auto ds : m_levels[idx]) {
+                sizes.push_back(ds->record_count());
+            }
+        }
+
+        return sizes;
+    }
+
+    /*
+     * Returns the total number of records that have been built into
+     * structures, including those rebuilt by reconstructions. Divided by
+     * the number of records inserted, this is the write amplification.
+     */
+    size_t get_write_count() {
+        return m_write_cnt;
+    }
+
+private:
+    size_t m_buffer_cap;
+    LayoutPolicy m_policy;
+    size_t m_scale_factor;
+    size_t m_write_cnt;
+
+    record_set m_buffer;
+    std::vector<std::vector<DS*>> m_levels;
+
+    /*
+     * Add the buffer's records to the levels, as a new structure,
+     * reconstructing levels according to the layout policy. Reconstructions
+     * gather the records of each structure involved as a separate run, so
+     * that they can be merged rather than re-sorted.
+     */
+    void flush_buffer() {
+        std::vector<record_set> runs;
+        runs.push_back(std::move(m_buffer));
+        m_buffer = record_set();
+        m_buffer.reserve(m_buffer_cap);
+
+        if constexpr (MergeBuildInterface<DS, R>) {
+            std::sort(runs[0].begin(), runs[0].end());
+        }
+
+        switch (m_policy) {
+        case LayoutPolicy::LEVELING:
+            reconstruct_leveling(runs);
+            break;
+        case LayoutPolicy::TIERING:
+            reconstruct_tiering(runs);
+            break;
+        default:
+            reconstruct_binary(runs);
+        }
+    }
+
+    /*
+     * Merge the runs with the full prefix of levels, into the first empty
+     * level.
+     */
+    void reconstruct_binary(std::vector<record_set> &runs) {
+        size_t target_idx = 0;
+        while (target_idx < m_levels.size() && m_levels[target_idx].size() > 0) {
+            unbuild_level(target_idx, runs);
+            target_idx++;
+        }
+
+        place(target_idx, runs);
+    }
+
+    /*
+     * Merge the runs into the first level, and while the result exceeds
+     * that level's capacity, carry it on to be merged into the next.
+     */
+    void reconstruct_leveling(std::vector<record_set> &runs) {
+        size_t capacity = m_buffer_cap * m_scale_factor;
+        for (size_t i=0; ; i++, capacity *= m_scale_factor) {
+            unbuild_level(i, runs);
+
+            if (run_size(runs) <= capacity) {
+                place(i, runs);
+                return;
+            }
+        }
+    }
+
+    /*
+     * Add the runs to the first level as a new structure. If that level
+     * already holds scale_factor structures, they are first merged into a
+     * single structure on the next level, which in turn is made room for in
+     * the same way.
+     */
+    void reconstruct_tiering(std::vector<record_set> &runs) {
+        size_t free_idx = 0;
+        while (free_idx < m_levels.size() && m_levels[free_idx].size() >= m_scale_factor) {
+            free_idx++;
+        }
+
+        for (size_t i=free_idx; i>0; i--) {
+            std::vector<record_set> level_runs;
+            unbuild_level(i - 1, level_runs);
+            place(i, level_runs);
+        }
+
+        place(0, runs);
+    }
+
+    /*
+     * Deconstruct all of the structures in level idx (if it exists),
+     * adding the records of each to runs.
+     */
+    void unbuild_level(size_t idx, std::vector<record_set> &runs) {
+        if (idx >= m_levels.size()) {
+            return;
+        }
+
+        for (auto ds : m_levels[idx]) {
+            runs.push_back(ds->unbuild());
+            delete ds;
+        }
+
+        m_levels[idx].clear();
+    }
+
+    /*
+     * Build the runs into a new structure in level idx, growing the
+     * structure if necessary.
+     */
+    void place(size_t idx, std::vector<record_set> &runs) {
+        if (idx >= m_levels.size()) {
+            m_levels.resize(idx + 1);
+        }
+
+        m_write_cnt += run_size(runs);
+        m_levels[idx].push_back(build_from_sorted_runs<R, DS>(runs));
+    }
+
+    static size_t run_size(const std::vector<record_set> &runs) {
+        size_t cnt = 0;
+        for (auto &run : runs) {
+            cnt += run.size();
+        }
+
+        return cnt;
+    }
+};
+
+
+template <typename R, ConcurrentBentleyInterface<R> DS>
+class ConcurrentBentleySaxe {
+    typedef std::vector<R> result_set;
+    typedef std::vector<R> record_set;
+
+    /*
+     * An immutable snapshot of the structure. Levels that have been
+     * filled from the buffer, but not yet merged into the levels, are
+     * held in pending, oldest first. A structure is freed once no
+     * version (and so no in-progress query) refers to it.
+     */
+    struct version {
+        std::vector<std::shared_ptr<DS>> levels;
+        std::deque<std::shared_ptr<DS>> pending;
+    };
+
+public:
+    /*
+     * Create a structure whose buffer holds buffer_cap records. Once more
+     * than max_pending full buffers are waiting to be merged, an insert
+     * that fills the buffer blocks until the background thread catches up.
+     */
+    ConcurrentBentleySaxe(size_t buffer_cap=1024, size_t max_pending=4)
+        : m_buffer_cap(std::max<size_t>(buffer_cap, 1)), m_max_pending(std::max<size_t>(max_pending, 1))
+        , m_version(std::make_shared<version>()), m_shutdown(false) {
+        m_buffer.reserve(m_buffer_cap);
+        m_merge_thread = std::thread(&ConcurrentBentleySaxe::merge_loop, this);
+    }
+
+    ~ConcurrentBentleySaxe() {
+        {
+            std::unique_lock<std::mutex> lock(m_version_lock);
+            m_shutdown = true;
+        }
+
+        m_merge_cv.notify_all();
+        m_merge_thread.join();
+    }
+
+    /*
+     * Insert rec into the buffer. If this fills the buffer, its records
+     * are built into a structure and handed off to the background thread
+     * to be merged, so an insert costs at most a build over buffer_cap
+     * records, plus any wait imposed by max_pending.
+     */
+    void insert(const R &rec) {
+        std::unique_lock<std::mutex> buffer_lock(m_buffer_lock);
+        m_buffer.push_back(rec);
+
+        if (m_buffer.size() < m_buffer_cap) {
+            return;
+        }
+
+        auto ds = std::shared_ptr<DS>(DS::build(m_buffer));
+        m_buffer.clear();
+        m_buffer.reserve(m_buffer_cap);
+
+        std::unique_lock<std::mutex> lock(m_version_lock);
+        auto next = std::make_shared<version>(*m_version);
+        next->pending.push_back(std::move(ds));
+        m_version = std::move(next);
+
+        buffer_lock.unlock();
+        m_merge_cv.notify_one();
+
+        /* wait for the merges to catch up, without blocking queries or other inserts */
+        m_pending_cv.wait(lock, [&] { return m_version->pending.size() <= m_max_pending; });
+    }
+
+    /*
+     * Answer q against a consistent snapshot of the buffer and levels.
+     * Merges that complete while the query runs do not affect it.
+     */
     result_set query(void *q) {
         assert(q != nullptr);
 
+        record_set buffer;
+        std::shared_ptr<const version> snapshot;
+        {
+            std::unique_lock<std::mutex> buffer_lock(m_buffer_lock);
+            buffer = m_buffer;
+            snapshot = get_version();
+        }
+
         result_set results;
-        for (size_t i=0; i<m_levels.size(); i++) {
-            if (m_levels[i]) {
-                auto temp = m_levels[i]->query(q);
-                results = m_levels[i]->query_merge(results, temp);
+        auto query_ds = [&](DS *ds) {
+            auto temp = ds->query(q);
+            results = ds->query_merge(results, temp);
+        };
+
+        if (buffer.size() > 0) {
+            std::unique_ptr<DS> buffer_ds(DS::build(buffer));
+            query_ds(buffer_ds.get());
+        }
+
+        for (auto &ds : snapshot->pending) {
+            query_ds(ds.get());
+        }
+
+        for (auto &ds : snapshot->levels) {
+            if (ds) {
+                query_ds(ds.get());
             }
         }
 
-        return std::move(results);
+        return results;
     }
 
     size_t record_count() {
-        size_t total = 0;
-        for (size_t i=0; i<m_levels.size(); i++) {
-            if (m_levels[i]) {
-                total += m_levels[i]->record_count();
+        std::unique_lock<std::mutex> buffer_lock(m_buffer_lock);
+        size_t total = m_buffer.size();
+        auto snapshot = get_version();
+        buffer_lock.unlock();
+
+        for (auto &ds : snapshot->pending) {
+            total += ds->record_count();
+        }
+
+        for (auto &ds : snapshot->levels) {
+            if (ds) {
+                total += ds->record_count();
             }
         }
 
         return total;
     }
 
+    /*
+     * Returns the number of full buffers waiting to be merged.
+     */
+    size_t pending_count() {
+        return get_version()->pending.size();
+    }
+
+    /*
+     * Block until every full buffer has been merged into the levels.
+     */
+    void await_merges() {
+        std::unique_lock<std::mutex> lock(m_version_lock);
+        m_pending_cv.wait(lock, [&] { return m_version->pending.empty(); });
+    }
+
 private:
-    std::vector<DS*> m_levels;
+    size_t m_buffer_cap;
+    size_t m_max_pending;
+
+    std::mutex m_buffer_lock;
+    record_set m_buffer;
+
+    /*
+     * The current version. It is only replaced, never modified, and is
+     * guarded by m_version_lock, which is always taken after
+     * m_buffer_lock when both are needed.
+     */
+    std::mutex m_version_lock;
+    std::shared_ptr<const version> m_version;
+    std::condition_variable m_merge_cv;
+    std::condition_variable m_pending_cv;
+    bool m_shutdown;
+
+    std::thread m_merge_thread;
+
+    std::shared_ptr<const version> get_version() {
+        std::unique_lock<std::mutex> lock(m_version_lock);
+        return m_version;
+    }
+
+    /*
+     * Merge the oldest pending structure into the levels, one at a time,
+     * in the same manner as BentleySaxe::insert. The merged level is built
+     * from copies of the records, without holding any lock, and then
+     * swapped in.
+     */
+    void merge_loop() {
+        while (true) {
+            std::shared_ptr<const version> snapshot;
+            {
+                std::unique_lock<std::mutex> lock(m_version_lock);
+                m_merge_cv.wait(lock, [&] { return m_shutdown || !m_version->pending.empty(); });
+                if (m_shutdown) {
+                    return;
+                }
+
+                snapshot = m_version;
+            }
+
+            /* find the first empty level, collecting the records of those before it */
+            std::vector<record_set> runs;
+            runs.push_back(copy_records(snapshot->pending.front().get()));
+
+            size_t target_idx = 0;
+            while (target_idx < snapshot->levels.size() && snapshot->levels[target_idx]) {
+                runs.push_back(copy_records(snapshot->levels[target_idx].get()));
+                target_idx++;
+            }
+
+            auto merged = std::shared_ptr<DS>(build_from_sorted_runs<R, DS>(runs));
+
+            /*
+             * Only this thread changes the levels or removes pending
+             * structures, so the current version differs from the snapshot
+             * at most by structures added to the back of pending.
+             */
+            {
+                std::unique_lock<std::mutex> lock(m_version_lock);
+                auto next = std::make_shared<version>(*m_version);
+
+                next->pending.pop_front();
+                if (target_idx == next->levels.size()) {
+                    next->levels.emplace_back();
+                }
+
+                for (size_t i=0; i<target_idx; i++) {
+                    next->levels[i] = nullptr;
+                }
+                next->levels[target_idx] = std::move(merged);
+
+                m_version = std::move(next);
+            }
+
+            m_pending_cv.notify_all();
+        }
+    }
+
+    /*
+     * Returns a copy of the records of ds, which are in sorted order.
+     */
+    static record_set copy_records(DS *ds) {
+        record_set records;
+        size_t cnt = ds->record_count();
+        records.reserve(cnt);
+        for (size_t i=0; i<cnt; i++) {
+            records.push_back(*ds->get_record_at(i));
+        }
+
+        return records;
+    }
 };
 
 }}
-
@@ -11,6 +11,7 @@
 #include <cstdlib>
 #include <cstdint>
 #include <cstddef>
+#include <array>
 
 namespace psudb {
 
@@ -105,4 +106,165 @@ inline uint64_t hash_bytes_with_salt(const char* str, size_t len,
     return rotr64(magic_num * hashState, 6);
 }
 
+/*
+ * Lookup table for crc32c, generated at compile time from the
+ * (reflected) Castagnoli polynomial.
+ */
+const uint32_t kCrc32cPoly = 0x82F63B78;
+
+constexpr std::array<uint32_t, 256> kCrc32cTable = []() {
+    std::array<uint32_t, 256> table = {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (size_t j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPoly : 0);
+        }
+        table[i] = crc;
+    }
+
+    return table;
+}();
+
+/*
+ * Calculate the CRC-32C checksum of a sequence of bytes, one byte at a
+ * time. Portable, but slow; crc32c should generally be used instead.
+ */
+inline uint32_t crc32c_sw(const std::byte* data, size_t len, uint32_t crc=0)
+{
+    crc = ~crc;
+    for (size_t idx = 0; idx < len; ++idx) {
+        crc = kCrc32cTable[(crc ^ (unsigned char) data[idx]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+/*
+ * Multiply two polynomials modulo the (reflected) CRC-32C polynomial.
+ */
+inline uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ kCrc32cPoly : b >> 1;
+    }
+
+    return p;
+}
+
+/*
+ * Tables used to advance a raw crc32c register past len zero bytes, in
+ * four byte-wise lookups. This allows the checksums of adjacent ranges,
+ * computed independently, to be combined.
+ */
+struct Crc32cShift {
+    uint32_t table[4][256];
+
+    explicit Crc32cShift(size_t len) {
+        /* x^(8 * len) mod P, by repeated squaring */
+        uint32_t op = 1u << 31;
+        uint32_t sq = 1u << 23;
+        for (size_t n = len; n > 0; n >>= 1) {
+            if (n & 1) {
+                op = crc32c_multmodp(sq, op);
+            }
+            sq = crc32c_multmodp(sq, sq);
+        }
+
+        for (size_t i = 0; i < 4; i++) {
+            for (uint32_t j = 0; j < 256; j++) {
+                table[i][j] = crc32c_multmodp(op, j << (8 * i));
+            }
+        }
+    }
+
+    uint32_t operator()(uint32_t crc) const {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF]
+             ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+    }
+};
+
+/*
+ * Calculate the CRC-32C checksum of a sequence of bytes using the SSE4.2
+ * crc32 instruction. Large inputs are processed as three interleaved
+ * streams, to hide the latency of the instruction, which are then
+ * combined. Must only be called if the CPU supports SSE4.2.
+ */
+__attribute__((target("sse4.2")))
+inline uint32_t crc32c_hw(const std::byte* data, size_t len, uint32_t crc=0)
+{
+    /* 3 * kStreamLen covers the bulk of a 4 KiB page */
+    constexpr size_t kStreamLen = 1360;
+    static const Crc32cShift shift(kStreamLen);
+
+    uint64_t c0 = (uint32_t) ~crc;
+
+    while (len > 0 && ((uintptr_t) data & 7)) {
+        c0 = __builtin_ia32_crc32qi(c0, (unsigned char) *data);
+        data++;
+        len--;
+    }
+
+    while (len >= 3 * kStreamLen) {
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+        const uint64_t *p0 = (const uint64_t *) data;
+        const uint64_t *p1 = (const uint64_t *) (data + kStreamLen);
+        const uint64_t *p2 = (const uint64_t *) (data + 2 * kStreamLen);
+
+        for (size_t i = 0; i < kStreamLen / 8; i++) {
+            c0 = __builtin_ia32_crc32di(c0, p0[i]);
+            c1 = __builtin_ia32_crc32di(c1, p1[i]);
+            c2 = __builtin_ia32_crc32di(c2, p2[i]);
+        }
+
+        c0 = shift(shift((uint32_t) c0) ^ (uint32_t) c1) ^ (uint32_t) c2;
+
+        data += 3 * kStreamLen;
+        len -= 3 * kStreamLen;
+    }
+
+    while (len >= 8) {
+        c0 = __builtin_ia32_crc32di(c0, *(const uint64_t *) data);
+        data += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        c0 = __builtin_ia32_crc32qi(c0, (unsigned char) *data);
+        data++;
+        len--;
+    }
+
+    return ~(uint32_t) c0;
+}
+#endif
+
+/*
+ * Calculate the CRC-32C checksum of a sequence of bytes. A checksum
+ * of several discontiguous ranges can be computed by passing the
+ * result for the previous range as crc. Uses the SSE4.2 instruction
+ * where the CPU supports it.
+ */
+inline uint32_t crc32c(const std::byte* data, size_t len, uint32_t crc=0)
+{
+#if defined(__x86_64__)
+    static const bool hw = __builtin_cpu_supports("sse4.2");
+    if (hw) {
+        return crc32c_hw(data, len, crc);
+    }
+#endif
+
+    return crc32c_sw(data, len, crc);
+}
+
 }
@@ -0,0 +1,188 @@
+/*
+ * include/psu-util/parallel.h
+ *
+ * Copyright (C) 2023 Douglas Rumbaugh <drumbaugh@psu.edu>
+ *
+ * All rights reserved. Published under the Revised BSD License.
+ *
+ * Simple fork-join parallel primitives built directly on std::thread: a
+ * parallel loop over an index range, and a parallel sort and merge. Each
+ * call creates its own threads, so these are intended for large, bulk
+ * operations (such as building a data structure), where the cost of
+ * thread creation is negligible.
+ */
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace psudb {
+
+/*
+ * The smallest number of elements that parallel_sort and parallel_merge_runs
+ * will assign to a single thread.
+ */
+const size_t PARALLEL_MIN_ELEMENTS = 1 << 14;
+
+/*
+ * Split the range [0, cnt) into at most thread_cnt contiguous pieces of at
+ * least min_per_thread indices each, and call f(start, stop) on each piece
+ * concurrently. The calling thread handles the first piece. If thread_cnt
+ * is 0 or 1, f(0, cnt) is simply called directly.
+ */
+template <typename F>
+void parallel_for(size_t cnt, size_t thread_cnt, F &&f, size_t min_per_thread=1) {
+    min_per_thread = std::max<size_t>(min_per_thread, 1);
+    thread_cnt = std::min(thread_cnt, (cnt + min_per_thread - 1) / min_per_thread);
+
+    if (thread_cnt <= 1) {
+        f((size_t) 0, cnt);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t t=1; t<thread_cnt; t++) {
+        threads.emplace_back(f, cnt * t / thread_cnt, cnt * (t + 1) / thread_cnt);
+    }
+
+    f((size_t) 0, cnt / thread_cnt);
+
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/*
+ * Returns the number of elements of a within the first d elements of the
+ * stable merge of the sorted ranges a[0, a_len) and b[0, b_len), in which
+ * elements of a precede equal elements of b.
+ */
+template <typename T, typename Compare>
+size_t merge_co_rank(size_t d, const T *a, size_t a_len, const T *b, size_t b_len, Compare comp) {
+    size_t lo = (d > b_len) ? d - b_len : 0;
+    size_t hi = std::min(d, a_len);
+
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = d - i;
+
+        /* a[i] is merged before b[j-1], so more than i elements of a are included */
+        if (j > 0 && !comp(b[j-1], a[i])) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Merge the adjacent sorted runs of the range starting at begin into a
+ * single sorted run. Run i covers [begin + bounds[i], begin + bounds[i+1]),
+ * and bounds[0] must be 0. Pairs of runs are merged in rounds; within each
+ * round, every merge is split into independent pieces of equal size using
+ * merge_co_rank, so that all thread_cnt threads are used even once only a
+ * few runs remain. The merge is stable.
+ */
+template <typename RandomIt, typename Compare=std::less<>>
+void parallel_merge_runs(RandomIt begin, std::vector<size_t> bounds, size_t thread_cnt, Compare comp=Compare()) {
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+
+    if (bounds.size() <= 2) {
+        return;
+    }
+
+    size_t n = bounds.back();
+    std::vector<T> buffer(n);
+    T *src = &*begin;
+    T *dst = buffer.data();
+
+    struct piece {
+        size_t a_start, a_len, b_start, b_len;
+        size_t d_start, d_stop;
+    };
+
+    while (bounds.size() > 2) {
+        size_t run_cnt = bounds.size() - 1;
+        size_t pair_cnt = (run_cnt + 1) / 2;
+        size_t splits = std::max<size_t>(1, thread_cnt / pair_cnt);
+
+        std::vector<piece> pieces;
+        std::vector<size_t> next_bounds = {0};
+
+        for (size_t r=0; r<run_cnt; r+=2) {
+            size_t a_start = bounds[r];
+            size_t b_start = bounds[r + 1];
+            size_t stop = (r + 2 < bounds.size()) ? bounds[r + 2] : b_start;
+            size_t len = stop - a_start;
+
+            size_t k = std::max<size_t>(1, std::min(splits, len / PARALLEL_MIN_ELEMENTS));
+            for (size_t s=0; s<k; s++) {
+                pieces.push_back({a_start, b_start - a_start, b_start, stop - b_start, len * s / k, len * (s + 1) / k});
+            }
+
+            next_bounds.push_back(stop);
+        }
+
+        parallel_for(pieces.size(), thread_cnt, [&](size_t start, size_t stop) {
+            for (size_t p=start; p<stop; p++) {
+                auto &pc = pieces[p];
+                const T *a = src + pc.a_start;
+                const T *b = src + pc.b_start;
+
+                size_t i0 = merge_co_rank(pc.d_start, a, pc.a_len, b, pc.b_len, comp);
+                size_t i1 = merge_co_rank(pc.d_stop, a, pc.a_len, b, pc.b_len, comp);
+                size_t j0 = pc.d_start - i0;
+                size_t j1 = pc.d_stop - i1;
+
+                std::merge(a + i0, a + i1, b + j0, b + j1, dst + pc.a_start + pc.d_start, comp);
+            }
+        });
+
+        std::swap(src, dst);
+        bounds = std::move(next_bounds);
+    }
+
+    /* an odd number of rounds leaves the result in the buffer */
+    if (src != &*begin) {
+        parallel_for(n, thread_cnt, [&](size_t start, size_t stop) {
+            std::copy(src + start, src + stop, dst + start);
+        }, PARALLEL_MIN_ELEMENTS);
+    }
+}
+
+/*
+ * Sort the range [begin, end) using up to thread_cnt threads, by sorting
+ * one piece per thread and then merging the pieces with
+ * parallel_merge_runs. Unlike std::sort, the sort is not in-place, and
+ * requires a temporary buffer of the same size as the range.
+ */
+template <typename RandomIt, typename Compare=std::less<>>
+void parallel_sort(RandomIt begin, RandomIt end, size_t thread_cnt, Compare comp=Compare()) {
+    size_t n = end - begin;
+    thread_cnt = std::min(thread_cnt, n / PARALLEL_MIN_ELEMENTS);
+
+    if (thread_cnt <= 1) {
+        std::sort(begin, end, comp);
+        return;
+    }
+
+    std::vector<size_t> bounds(thread_cnt + 1);
+    for (size_t i=0; i<=thread_cnt; i++) {
+        bounds[i] = n * i / thread_cnt;
+    }
+
+    parallel_for(thread_cnt, thread_cnt, [&](size_t start, size_t stop) {
+        for (size_t i=start; i<stop; i++) {
+            std::sort(begin + bounds[i], begin + bounds[i + 1], comp);
+        }
+    });
+
+    parallel_merge_runs(begin, std::move(bounds), thread_cnt, comp);
+}
+
+}
@@ -15,9 +15,10 @@ namespace psudb {
 
 /*
  * The number of bytes of zeroes available in ZEROBUFF. Will be
- * a multiple of the PAGE_SIZE.
+ * a multiple of the PAGE_SIZE, and at least as large as the
+ * largest supported page size.
  */
-constexpr size_t ZEROBUFF_SIZE = 8 * PAGE_SIZE;
+constexpr size_t ZEROBUFF_SIZE = 16 * PAGE_SIZE;
 
 /*
  * A large sector aligned buffer of zeroes. Useful for initializing
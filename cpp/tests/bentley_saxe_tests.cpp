@@ -7,10 +7,13 @@
 
 #include "psu-util/bentley-saxe.h"
 #include "psu-ds/StaticISAM.h"
+#include "psu-ds/PriorityQueue.h"
 
 #include <algorithm>
 #include <random>
 #include <cstdlib>
+#include <thread>
+#include <atomic>
 
 #include <check.h>
 
@@ -18,6 +21,35 @@ typedef int64_t key_type;
 typedef int64_t val_type;
 
 typedef std::pair<key_type, val_type> record_t;
+typedef psudb::ISAMTree<key_type, val_type> isam_t;
+
+/* a structure that can only be built by sorting, to exercise both reconstruction paths */
+struct sorted_vector {
+    std::vector<record_t> data;
+
+    static sorted_vector *build(std::vector<record_t> &records) {
+        std::sort(records.begin(), records.end());
+        return new sorted_vector{std::move(records)};
+    }
+
+    std::vector<record_t> unbuild() { return std::move(data); }
+    size_t record_count() { return data.size(); }
+
+    std::vector<record_t> query(void *q) {
+        auto parms = (isam_t::RangeQueryParameters *) q;
+        auto first = std::lower_bound(data.begin(), data.end(), record_t{parms->lower_bound, INT64_MIN});
+        auto last = std::lower_bound(data.begin(), data.end(), record_t{parms->upper_bound, INT64_MIN});
+        return std::vector<record_t>(first, last);
+    }
+
+    std::vector<record_t> query_merge(std::vector<record_t> &rsa, std::vector<record_t> &rsb) {
+        rsa.insert(rsa.end(), rsb.begin(), rsb.end());
+        return std::move(rsa);
+    }
+};
+
+static_assert(psudb::bsm::MergeBuildInterface<isam_t, record_t>);
+static_assert(!psudb::bsm::MergeBuildInterface<sorted_vector, record_t>);
 
 START_TEST(t_create)
 {
@@ -87,6 +119,312 @@ START_TEST(t_query)
 END_TEST
 
 
+START_TEST(t_insert_batch)
+{
+    auto bs = psudb::bsm::BentleySaxe<record_t, isam_t>(1000);
+
+    std::vector<record_t> records;
+    for (size_t i=0; i<10500; i++) {
+        records.push_back({(key_type) ((i * 7919) % 10500), i});
+    }
+
+    /* batches that do and do not line up with the buffer's capacity */
+    bs.insert_batch(std::span<const record_t>(records).subspan(0, 999));
+    ck_assert_int_eq(bs.record_count(), 999);
+    bs.insert_batch(std::span<const record_t>(records).subspan(999, 2001));
+    ck_assert_int_eq(bs.record_count(), 3000);
+    bs.insert_batch(std::span<const record_t>(records).subspan(3000));
+    ck_assert_int_eq(bs.record_count(), 10500);
+
+    /* the 500 records left in the buffer are queried too */
+    isam_t::RangeQueryParameters parm;
+    parm.lower_bound = 0;
+    parm.upper_bound = 10500;
+
+    auto res = bs.query(&parm);
+    ck_assert_int_eq(res.size(), 10500);
+
+    std::sort(res.begin(), res.end());
+    for (size_t i=0; i<res.size(); i++) {
+        ck_assert_int_eq(res[i].first, i);
+    }
+}
+END_TEST
+
+
+START_TEST(t_buffered_insert)
+{
+    auto bs = psudb::bsm::BentleySaxe<record_t, isam_t>(64);
+
+    for (size_t i=0; i<1000; i++) {
+        record_t rec = {(key_type) i, i};
+        bs.insert(rec);
+        ck_assert_int_eq(bs.record_count(), i + 1);
+    }
+
+    isam_t::RangeQueryParameters parm;
+    parm.lower_bound = 950;
+    parm.upper_bound = 2000;
+    ck_assert_int_eq(bs.query(&parm).size(), 50);
+}
+END_TEST
+
+
+START_TEST(t_layout_policies)
+{
+    using psudb::bsm::LayoutPolicy;
+    size_t n = 20000;
+    size_t buffer_cap = 100;
+
+    for (auto policy : {LayoutPolicy::BINARY, LayoutPolicy::LEVELING, LayoutPolicy::TIERING}) {
+        for (size_t sf : {2, 4, 8}) {
+            auto bs = psudb::bsm::BentleySaxe<record_t, isam_t>(buffer_cap, policy, sf);
+
+            for (size_t i=0; i<n; i++) {
+                record_t rec = {(key_type) ((i * 7919) % n), i};
+                bs.insert(rec);
+            }
+
+            ck_assert_int_eq(bs.record_count(), n);
+            ck_assert_int_ge(bs.get_write_count(), n);
+
+            if (policy == LayoutPolicy::TIERING) {
+                ck_assert_int_le(bs.structure_count(), bs.level_count() * sf);
+            } else {
+                ck_assert_int_le(bs.structure_count(), bs.level_count());
+            }
+
+            isam_t::RangeQueryParameters parm;
+            parm.lower_bound = 5000;
+            parm.upper_bound = 9000;
+
+            auto res = bs.query(&parm);
+            ck_assert_int_eq(res.size(), 4000);
+
+            std::sort(res.begin(), res.end());
+            for (size_t i=0; i<res.size(); i++) {
+                ck_assert_int_eq(res[i].first, 5000 + i);
+            }
+        }
+    }
+}
+END_TEST
+
+
+START_TEST(t_tiering_sizes)
+{
+    using psudb::bsm::LayoutPolicy;
+
+    /* three inserts fill level 0, so its two structures move down to level 1 */
+    auto small = psudb::bsm::BentleySaxe<record_t, isam_t>(1, LayoutPolicy::TIERING, 2);
+    for (size_t i=0; i<3; i++) {
+        small.insert({(key_type) i, i});
+    }
+
+    ck_assert(small.get_structure_sizes(0) == std::vector<size_t>{1});
+    ck_assert(small.get_structure_sizes(1) == std::vector<size_t>{2});
+
+    for (size_t sf : {2, 3, 4}) {
+        size_t buffer_cap = 8;
+        auto bs = psudb::bsm::BentleySaxe<record_t, isam_t>(buffer_cap, LayoutPolicy::TIERING, sf);
+
+        for (size_t i=0; i<5000 * buffer_cap; i++) {
+            bs.insert({(key_type) i, i});
+
+            if ((i + 1) % buffer_cap != 0) {
+                continue;
+            }
+
+            /* every structure on level i holds exactly sf^i buffers */
+            size_t total = 0;
+            size_t expected = buffer_cap;
+            for (size_t l=0; l<bs.level_count(); l++, expected *= sf) {
+                auto sizes = bs.get_structure_sizes(l);
+                ck_assert_int_le(sizes.size(), sf);
+                for (auto size : sizes) {
+                    ck_assert_int_eq(size, expected);
+                    total += size;
+                }
+            }
+
+            ck_assert_int_eq(total, i + 1);
+        }
+    }
+}
+END_TEST
+
+
+START_TEST(t_layout_tradeoff)
+{
+    using psudb::bsm::LayoutPolicy;
+    size_t n = 50000;
+
+    auto leveling = psudb::bsm::BentleySaxe<record_t, isam_t>(100, LayoutPolicy::LEVELING, 8);
+    auto tiering = psudb::bsm::BentleySaxe<record_t, isam_t>(100, LayoutPolicy::TIERING, 8);
+
+    for (size_t i=0; i<n; i++) {
+        record_t rec = {(key_type) i, i};
+        leveling.insert(rec);
+        tiering.insert(rec);
+    }
+
+    /* tiering rewrites records less often, but leaves more structures to query */
+    ck_assert_int_lt(tiering.get_write_count(), leveling.get_write_count());
+    ck_assert_int_gt(tiering.structure_count(), leveling.structure_count());
+}
+END_TEST
+
+
+START_TEST(t_merge_build)
+{
+    using psudb::bsm::LayoutPolicy;
+    size_t n = 30000;
+
+    for (auto policy : {LayoutPolicy::BINARY, LayoutPolicy::LEVELING, LayoutPolicy::TIERING}) {
+        auto merging = psudb::bsm::BentleySaxe<record_t, isam_t>(64, policy, 4);
+        auto sorting = psudb::bsm::BentleySaxe<record_t, sorted_vector>(64, policy, 4);
+
+        std::mt19937_64 rng(0);
+        for (size_t i=0; i<n; i++) {
+            record_t rec = {(key_type) (rng() % 10000), (val_type) i};
+            merging.insert(rec);
+            sorting.insert(rec);
+        }
+
+        ck_assert_int_eq(merging.record_count(), n);
+        ck_assert_int_eq(merging.get_write_count(), sorting.get_write_count());
+
+        isam_t::RangeQueryParameters parm;
+        parm.lower_bound = 2000;
+        parm.upper_bound = 7000;
+
+        auto a = merging.query(&parm);
+        auto b = sorting.query(&parm);
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        ck_assert(a == b);
+    }
+}
+END_TEST
+
+
+/* a record which is ordered by its key alone */
+struct keyed_record {
+    key_type key;
+    size_t run;
+
+    bool operator<(const keyed_record &other) const {
+        return key < other.key;
+    }
+};
+
+
+START_TEST(t_kway_merge_stable)
+{
+    /* cover the sort, two run, and queue paths */
+    for (size_t run_cnt : {2, 5}) {
+        for (size_t run_len : {10, 1000}) {
+            std::vector<std::vector<keyed_record>> runs(run_cnt);
+            for (size_t i=0; i<run_cnt; i++) {
+                for (size_t j=0; j<run_len; j++) {
+                    runs[i].push_back({(key_type) (j / 7), i});
+                }
+            }
+
+            auto merged = psudb::kway_merge(runs);
+            ck_assert_int_eq(merged.size(), run_cnt * run_len);
+
+            for (size_t i=1; i<merged.size(); i++) {
+                ck_assert_int_le(merged[i-1].key, merged[i].key);
+                if (merged[i-1].key == merged[i].key) {
+                    ck_assert_int_le(merged[i-1].run, merged[i].run);
+                }
+            }
+
+            for (auto &run : runs) {
+                ck_assert_int_eq(run.size(), 0);
+            }
+        }
+    }
+}
+END_TEST
+
+
+START_TEST(t_concurrent_insert)
+{
+    auto bs = psudb::bsm::ConcurrentBentleySaxe<record_t, isam_t>(100, 2);
+    ck_assert_int_eq(bs.record_count(), 0);
+
+    size_t n = 100000;
+    for (size_t i=0; i<n; i++) {
+        record_t rec = {(key_type) ((i * 7919) % n), i};
+        bs.insert(rec);
+    }
+
+    /* records are counted whether buffered, pending or merged */
+    ck_assert_int_eq(bs.record_count(), n);
+
+    bs.await_merges();
+    ck_assert_int_eq(bs.pending_count(), 0);
+    ck_assert_int_eq(bs.record_count(), n);
+
+    isam_t::RangeQueryParameters parm;
+    parm.lower_bound = 5000;
+    parm.upper_bound = 9000;
+
+    auto res = bs.query(&parm);
+    ck_assert_int_eq(res.size(), 4000);
+
+    std::sort(res.begin(), res.end());
+    for (size_t i=0; i<res.size(); i++) {
+        ck_assert_int_eq(res[i].first, 5000 + i);
+    }
+}
+END_TEST
+
+
+START_TEST(t_concurrent_query)
+{
+    auto bs = psudb::bsm::ConcurrentBentleySaxe<record_t, isam_t>(64, 1);
+
+    size_t n = 50000;
+    std::atomic<size_t> inserted = 0;
+
+    std::thread writer([&] {
+        for (size_t i=0; i<n; i++) {
+            record_t rec = {(key_type) i, i};
+            bs.insert(rec);
+            inserted.store(i + 1);
+        }
+    });
+
+    /*
+     * Every query sees each record at most once, and sees at least every
+     * record inserted before it started, however the merges interleave.
+     */
+    isam_t::RangeQueryParameters parm;
+    parm.lower_bound = 0;
+    parm.upper_bound = n;
+
+    size_t done = 0;
+    while (done < n) {
+        done = inserted.load();
+        auto res = bs.query(&parm);
+
+        ck_assert_int_ge(res.size(), done);
+        std::sort(res.begin(), res.end());
+        for (size_t i=0; i<res.size(); i++) {
+            ck_assert_int_eq(res[i].first, i);
+        }
+    }
+
+    writer.join();
+    bs.await_merges();
+    ck_assert_int_eq(bs.query(&parm).size(), n);
+}
+END_TEST
+
+
 Suite *unit_testing()
 {
     Suite *unit = suite_create("Bentley Saxe Framework Unit Tests");
@@ -99,12 +437,22 @@ Suite *unit_testing()
 
     TCase *insert = tcase_create("BentleySaxe::insert Unit Tests");
     tcase_add_test(insert, t_insert);
+    tcase_add_test(insert, t_insert_batch);
+    tcase_add_test(insert, t_buffered_insert);
+    tcase_add_test(insert, t_layout_policies);
+    tcase_add_test(insert, t_tiering_sizes);
+    tcase_add_test(insert, t_layout_tradeoff);
+    tcase_add_test(insert, t_merge_build);
+    tcase_add_test(insert, t_kway_merge_stable);
+    tcase_add_test(insert, t_concurrent_insert);
+    tcase_set_timeout(insert, 1000);
 
     suite_add_tcase(unit, insert);
 
 
     TCase *query = tcase_create("BentleySaxe::query Unit Tests");
     tcase_add_test(query, t_query);
+    tcase_add_test(query, t_concurrent_query);
     tcase_set_timeout(query, 1000);
 
     suite_add_tcase(unit, query);
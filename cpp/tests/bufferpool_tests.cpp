@@ -0,0 +1,227 @@
+/*
+ *  tests/bufferpool_tests.cpp
+ *
+ *  Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *  Distributed under the Modified BSD License.
+ */
+#include <string>
+
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+#include "psu-io/BufferPool.h"
+
+#include <check.h>
+
+using namespace psudb;
+
+std::string test_file = "bin/tests/data/bufferpool_file.dat";
+
+static std::unique_ptr<PagedFile> create_test_file(size_t page_cnt) {
+    auto pfile = PagedFile::create(test_file, true);
+    if (!pfile || pfile->allocate_pages(page_cnt) == INVALID_PNUM) {
+        return nullptr;
+    }
+
+    byte *page = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE);
+    for (size_t i=1; i<=page_cnt; i++) {
+        *((int *) page) = i;
+        pfile->write_page(i, page);
+    }
+    free(page);
+
+    return pfile;
+}
+
+
+template <EvictionPolicy P>
+static void pin_unpin_test() {
+    size_t pg_cnt = 100;
+    auto pfile = create_test_file(pg_cnt);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    BufferPool<P> pool(10);
+    ck_assert_int_eq(pool.frame_count(), 10);
+
+    for (size_t j=0; j<3; j++) {
+        for (size_t i=1; i<=pg_cnt; i++) {
+            FrameId frid = pool.pin(pfile.get(), i);
+            ck_assert_int_ne(frid, INVALID_FRID);
+            ck_assert_int_eq(*((int *) pool.get_frame(frid)), i);
+            ck_assert(pool.is_resident(pfile.get(), i));
+            pool.unpin(frid);
+        }
+    }
+
+    /* pinning a resident page again returns the same frame */
+    FrameId frid1 = pool.pin(pfile.get(), 5);
+    FrameId frid2 = pool.pin(pfile.get(), 5);
+    ck_assert_int_eq(frid1, frid2);
+
+    /* invalid pages cannot be pinned */
+    ck_assert_int_eq(pool.pin(pfile.get(), pg_cnt + 1), INVALID_FRID);
+
+    /* a pinned page is never evicted */
+    for (size_t i=1; i<=pg_cnt; i++) {
+        FrameId frid = pool.pin(pfile.get(), i);
+        ck_assert_int_ne(frid, INVALID_FRID);
+        pool.unpin(frid);
+    }
+
+    ck_assert(pool.is_resident(pfile.get(), 5));
+    ck_assert_int_eq(*((int *) pool.get_frame(frid1)), 5);
+
+    pool.unpin(frid1);
+    pool.unpin(frid2);
+}
+
+
+template <EvictionPolicy P>
+static void full_pool_test() {
+    size_t pg_cnt = 20;
+    auto pfile = create_test_file(pg_cnt);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    BufferPool<P> pool(4);
+    std::vector<FrameId> frames;
+    for (size_t i=1; i<=4; i++) {
+        frames.push_back(pool.pin(pfile.get(), i));
+        ck_assert_int_ne(frames.back(), INVALID_FRID);
+    }
+
+    ck_assert_int_eq(pool.pin(pfile.get(), 10), INVALID_FRID);
+
+    pool.unpin(frames[2]);
+    FrameId frid = pool.pin(pfile.get(), 10);
+    ck_assert_int_eq(frid, frames[2]);
+    ck_assert_int_eq(*((int *) pool.get_frame(frid)), 10);
+    ck_assert(!pool.is_resident(pfile.get(), 3));
+}
+
+
+template <EvictionPolicy P>
+static void write_back_test() {
+    size_t pg_cnt = 20;
+    auto pfile = create_test_file(pg_cnt);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    BufferPool<P> pool(4);
+
+    for (size_t i=1; i<=pg_cnt; i++) {
+        FrameId frid = pool.pin(pfile.get(), i);
+        ck_assert_int_ne(frid, INVALID_FRID);
+        *((int *) pool.get_frame(frid)) = 1000 + i;
+        pool.unpin(frid, i % 2 == 0);
+    }
+
+    ck_assert_int_eq(pool.flush_file(pfile.get()), 1);
+
+    byte *page = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE);
+    for (size_t i=1; i<=pg_cnt; i++) {
+        ck_assert_int_eq(pfile->read_page(i, page), 1);
+        ck_assert_int_eq(*((int *) page), (i % 2 == 0) ? 1000 + i : i);
+    }
+    free(page);
+
+    pool.discard_file(pfile.get());
+    for (size_t i=1; i<=pg_cnt; i++) {
+        ck_assert(!pool.is_resident(pfile.get(), i));
+    }
+}
+
+
+START_TEST(t_pin_unpin_clock) { pin_unpin_test<ClockPolicy>(); } END_TEST
+START_TEST(t_pin_unpin_lruk) { pin_unpin_test<LRUKPolicy<2>>(); } END_TEST
+START_TEST(t_pin_unpin_2q) { pin_unpin_test<TwoQPolicy>(); } END_TEST
+
+START_TEST(t_full_pool_clock) { full_pool_test<ClockPolicy>(); } END_TEST
+START_TEST(t_full_pool_lruk) { full_pool_test<LRUKPolicy<2>>(); } END_TEST
+START_TEST(t_full_pool_2q) { full_pool_test<TwoQPolicy>(); } END_TEST
+
+START_TEST(t_write_back_clock) { write_back_test<ClockPolicy>(); } END_TEST
+START_TEST(t_write_back_lruk) { write_back_test<LRUKPolicy<2>>(); } END_TEST
+START_TEST(t_write_back_2q) { write_back_test<TwoQPolicy>(); } END_TEST
+
+
+START_TEST(t_scan_resistance_2q)
+{
+    size_t pg_cnt = 100;
+    auto pfile = create_test_file(pg_cnt);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    BufferPool<TwoQPolicy> pool(8);
+
+    /*
+     * Fill the pool, and then force the first two pages out. Requesting
+     * them again while they are remembered in the ghost queue promotes them
+     * into the hot set, which a subsequent scan should not disturb.
+     */
+    for (size_t i=1; i<=10; i++) {
+        pool.unpin(pool.pin(pfile.get(), i));
+    }
+
+    ck_assert(!pool.is_resident(pfile.get(), 1));
+    ck_assert(!pool.is_resident(pfile.get(), 2));
+
+    for (size_t i=1; i<=2; i++) {
+        pool.unpin(pool.pin(pfile.get(), i));
+    }
+
+    for (size_t i=11; i<=pg_cnt; i++) {
+        pool.unpin(pool.pin(pfile.get(), i));
+    }
+
+    for (size_t i=1; i<=2; i++) {
+        ck_assert(pool.is_resident(pfile.get(), i));
+    }
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("BufferPool Unit Testing");
+
+    TCase *pin = tcase_create("BufferPool::pin Testing");
+    tcase_add_test(pin, t_pin_unpin_clock);
+    tcase_add_test(pin, t_pin_unpin_lruk);
+    tcase_add_test(pin, t_pin_unpin_2q);
+    tcase_add_test(pin, t_full_pool_clock);
+    tcase_add_test(pin, t_full_pool_lruk);
+    tcase_add_test(pin, t_full_pool_2q);
+    suite_add_tcase(unit, pin);
+
+    TCase *flush = tcase_create("BufferPool::flush Testing");
+    tcase_add_test(flush, t_write_back_clock);
+    tcase_add_test(flush, t_write_back_lruk);
+    tcase_add_test(flush, t_write_back_2q);
+    suite_add_tcase(unit, flush);
+
+    TCase *policy = tcase_create("EvictionPolicy Testing");
+    tcase_add_test(policy, t_scan_resistance_2q);
+    suite_add_tcase(unit, policy);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main() 
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
@@ -0,0 +1,234 @@
+/*
+ *  tests/compressed_isam_tests.cpp
+ *
+ *  Copyright (C) 2023-2024 Douglas B. Rumbaugh <doug@douglasrumbaugh.com>
+ *  Distributed under the Modified BSD License.
+ */
+
+#include "psu-ds/CompressedISAM.h"
+#include "psu-util/bentley-saxe.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+
+/* WARNING: due to #define issues, must include this header LAST in C++ projects */
+#include <check.h>
+
+typedef int64_t key_type;
+typedef int64_t val_type;
+typedef std::pair<key_type, val_type> record_t;
+typedef psudb::CompressedISAMTree<key_type, val_type> isam_t;
+
+static_assert(psudb::bsm::BentleyInterface<isam_t, record_t>);
+static_assert(psudb::bsm::MergeBuildInterface<isam_t, record_t>);
+
+
+START_TEST(t_build)
+{
+    size_t n = 10000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) rand(), i});
+    }
+
+    auto copy = records;
+    std::sort(copy.begin(), copy.end());
+
+    auto isam = isam_t::build(records);
+    ck_assert_int_eq(isam->record_count(), n);
+    ck_assert_int_eq(isam->block_count(), (n + 127) / 128);
+
+    isam_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+    ck_assert(isam->query(&q) == copy);
+
+    record_t rec;
+    ck_assert_int_eq(isam->get_record(1234, &rec), 1);
+    ck_assert(rec == copy[1234]);
+    ck_assert_int_eq(isam->get_record(n, &rec), 0);
+
+    ck_assert(isam->unbuild() == copy);
+    ck_assert_int_eq(isam->record_count(), 0);
+    ck_assert_int_eq(isam->query(&q).size(), 0);
+
+    delete isam;
+}
+END_TEST
+
+
+START_TEST(t_build_empty)
+{
+    std::vector<record_t> records;
+    auto isam = isam_t::build(records);
+
+    ck_assert_int_eq(isam->record_count(), 0);
+    ck_assert_int_eq(isam->block_count(), 0);
+    ck_assert_int_eq(isam->lower_bound(5), 0);
+
+    isam_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+    ck_assert_int_eq(isam->query(&q).size(), 0);
+
+    delete isam;
+}
+END_TEST
+
+
+START_TEST(t_compression)
+{
+    /* dense keys need a single byte per key */
+    size_t n = 128000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) (1000000000 + 2 * i), i});
+    }
+
+    auto isam = isam_t::build_presorted(records);
+    ck_assert_int_eq(isam->block_count(), 1000);
+    ck_assert_int_eq(isam->data_memory_usage(), n * (1 + sizeof(val_type)) + 1000);
+
+    for (size_t i=0; i<1000; i++) {
+        key_type key = 1000000000 + rand() % (2 * n + 10) - 5;
+        size_t expected = (key < 1000000000) ? 0 : std::min<size_t>((key - 1000000000 + 1) / 2, n);
+        ck_assert_int_eq(isam->lower_bound(key), expected);
+    }
+
+    delete isam;
+}
+END_TEST
+
+
+template <typename K>
+static void check_key_type(std::vector<K> spreads)
+{
+    typedef psudb::CompressedISAMTree<K, int64_t, 32> index_t;
+    std::mt19937_64 rng(spreads.size());
+
+    for (K spread : spreads) {
+        for (size_t n : {(size_t) 1, (size_t) 31, (size_t) 33, (size_t) 20000}) {
+            std::vector<std::pair<K, int64_t>> records;
+            std::vector<K> keys;
+            for (size_t i=0; i<n; i++) {
+                /* duplicates are likely, as the spread is often small relative to n */
+                K key = (K) (rng() % (uint64_t) spread);
+                if constexpr (std::is_signed_v<K>) {
+                    key -= spread / 2;
+                }
+
+                records.push_back({key, i});
+                keys.push_back(key);
+            }
+
+            auto sorted = records;
+            std::sort(sorted.begin(), sorted.end());
+            std::sort(keys.begin(), keys.end());
+
+            auto isam = index_t::build(records);
+
+            for (size_t i=0; i<300; i++) {
+                K key = (K) (rng() % (uint64_t) spread);
+                if constexpr (std::is_signed_v<K>) {
+                    key -= spread / 2;
+                }
+
+                size_t expected = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+                ck_assert_int_eq(isam->lower_bound(key), expected);
+
+                typename index_t::RangeQueryParameters q;
+                q.lower_bound = key;
+                q.upper_bound = key + spread / 64 + 1;
+                if (q.upper_bound < q.lower_bound) {
+                    q.upper_bound = std::numeric_limits<K>::max();
+                }
+
+                auto result = isam->query(&q);
+                auto last = std::lower_bound(keys.begin(), keys.end(), q.upper_bound);
+                ck_assert_int_eq(result.size(), (last - keys.begin()) - expected);
+                for (size_t j=0; j<result.size(); j++) {
+                    ck_assert(result[j] == sorted[expected + j]);
+                }
+            }
+
+            delete isam;
+        }
+    }
+}
+
+
+START_TEST(t_query_key_types)
+{
+    check_key_type<int32_t>({100, 60000, 2000000000});
+    check_key_type<uint32_t>({200, 4000000000u});
+    check_key_type<int64_t>({100, 60000, 4000000000, INT64_MAX});
+    check_key_type<uint64_t>({250, 10000000000, UINT64_MAX});
+    check_key_type<int16_t>({200, 30000});
+}
+END_TEST
+
+
+START_TEST(t_bentley_saxe)
+{
+    auto bs = psudb::bsm::BentleySaxe<record_t, isam_t>();
+
+    for (size_t i=0; i<5000; i++) {
+        record_t rec = {(key_type) ((i * 7919) % 5000), i};
+        bs.insert(rec);
+    }
+
+    ck_assert_int_eq(bs.record_count(), 5000);
+
+    isam_t::RangeQueryParameters parm;
+    parm.lower_bound = 1000;
+    parm.upper_bound = 1500;
+    ck_assert_int_eq(bs.query(&parm).size(), 500);
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("Compressed ISAM Tree Unit Testing");
+
+    TCase *build = tcase_create("Compressed ISAM Construction Testing");
+    tcase_add_test(build, t_build);
+    tcase_add_test(build, t_build_empty);
+    tcase_add_test(build, t_compression);
+
+    suite_add_tcase(unit, build);
+
+
+    TCase *query = tcase_create("Compressed ISAM Query Testing");
+    tcase_add_test(query, t_query_key_types);
+    tcase_add_test(query, t_bentley_saxe);
+
+    tcase_set_timeout(query, 1000);
+    suite_add_tcase(unit, query);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+/*
+ *  tests/freespacemap_tests.cpp
+ *
+ *  Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *  Distributed under the Modified BSD License.
+ */
+#include <string>
+
+#include <sys/stat.h>
+
+#include "psu-io/PagedFile.h"
+#include "psu-io/PagedFileIterator.h"
+#include "psu-io/FreeSpaceMap.h"
+
+#include <check.h>
+
+using namespace psudb;
+
+std::string test_file = "bin/tests/data/freespacemap_file.dat";
+
+
+START_TEST(t_allocate_release)
+{
+    auto pfile = PagedFile::create(test_file, true);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    auto map = FreeSpaceMap::create(pfile.get());
+    ck_assert_ptr_nonnull(map.get());
+    ck_assert_int_eq(map->get_root(), 1);
+    ck_assert_int_eq(map->free_count(), 0);
+
+    /* with no free pages, allocations grow the file */
+    ck_assert_int_eq(map->allocate(10), 2);
+    ck_assert_int_eq(map->allocate(10), 12);
+    ck_assert_int_eq(pfile->get_page_count(), 21);
+
+    ck_assert_int_eq(map->release(4, 3), 1);
+    ck_assert_int_eq(map->release(15, 5), 1);
+    ck_assert_int_eq(map->free_count(), 8);
+    ck_assert(map->is_free(5));
+    ck_assert(!map->is_free(7));
+
+    /* double frees, invalid pages, and the map itself are rejected */
+    ck_assert_int_eq(map->release(5), 0);
+    ck_assert_int_eq(map->release(0), 0);
+    ck_assert_int_eq(map->release(21, 2), 0);
+    ck_assert_int_eq(map->release(map->get_root()), 0);
+    ck_assert_int_eq(map->free_count(), 8);
+
+    /* extents are reused lowest-first, if they are large enough */
+    ck_assert_int_eq(map->allocate(4), 15);
+    ck_assert_int_eq(map->allocate(2), 4);
+    ck_assert_int_eq(map->allocate(1), 6);
+    ck_assert_int_eq(map->allocate(1), 19);
+    ck_assert_int_eq(map->free_count(), 0);
+    ck_assert_int_eq(map->allocate(1), 22);
+}
+END_TEST
+
+
+START_TEST(t_persistence)
+{
+    PageNum root;
+    {
+        auto pfile = PagedFile::create(test_file, true);
+        auto map = FreeSpaceMap::create(pfile.get());
+        root = map->get_root();
+
+        map->allocate(100);
+        for (PageNum p=2; p<100; p+=3) {
+            ck_assert_int_eq(map->release(p, 1, false), 1);
+        }
+
+        ck_assert_int_eq(map->flush(), 1);
+    }
+
+    auto pfile = PagedFile::create(test_file, false);
+    ck_assert_int_eq(FreeSpaceMap::open(pfile.get(), 3).get(), nullptr);
+
+    auto map = FreeSpaceMap::open(pfile.get(), root);
+    ck_assert_ptr_nonnull(map.get());
+    ck_assert_int_eq(map->free_count(), 33);
+
+    for (PageNum p=2; p<=101; p++) {
+        ck_assert_int_eq(map->is_free(p), p < 100 && (p - 2) % 3 == 0);
+    }
+}
+END_TEST
+
+
+START_TEST(t_multiple_chunks)
+{
+    auto pfile = PagedFile::create(test_file, true, true, 512);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    /* each 512 byte map page can track fewer than 4096 pages */
+    auto map = FreeSpaceMap::create(pfile.get());
+    ck_assert_int_eq(map->allocate(10000), 2);
+    ck_assert_int_eq(map->release(9000, 500), 1);
+    ck_assert_int_eq(map->release(100), 1);
+    ck_assert_int_eq(map->flush(), 1);
+
+    auto map2 = FreeSpaceMap::open(pfile.get(), map->get_root());
+    ck_assert_ptr_nonnull(map2.get());
+    ck_assert_int_eq(map2->free_count(), 501);
+    ck_assert(map2->is_free(9499));
+    ck_assert(!map2->is_free(9500));
+
+    ck_assert_int_eq(map2->allocate(400), 9000);
+    ck_assert_int_eq(map2->allocate(1), 100);
+}
+END_TEST
+
+
+START_TEST(t_checksums)
+{
+    PageNum root;
+    {
+        auto pfile = PagedFile::create(test_file, true);
+        pfile->enable_checksums();
+
+        auto map = FreeSpaceMap::create(pfile.get());
+        root = map->get_root();
+
+        /* enough pages that the last bits of the chunk would overlap the trailer */
+        ck_assert_int_eq(map->allocate(32670), 2);
+        ck_assert_int_eq(map->release(32600, 70), 1);
+        ck_assert_int_eq(map->release(10, 16), 1);
+        ck_assert_int_eq(map->flush(), 1);
+    }
+
+    auto pfile = PagedFile::create(test_file, false);
+    pfile->enable_checksums();
+
+    auto map = FreeSpaceMap::open(pfile.get(), root);
+    ck_assert_ptr_nonnull(map.get());
+    ck_assert_int_eq(map->free_count(), 86);
+    ck_assert(map->is_free(10));
+    ck_assert(map->is_free(25));
+    ck_assert(map->is_free(32669));
+    ck_assert(!map->is_free(26));
+}
+END_TEST
+
+
+START_TEST(t_discard)
+{
+    auto pfile = PagedFile::create(test_file, true);
+    auto map = FreeSpaceMap::create(pfile.get());
+
+    size_t pg_cnt = 256;
+    PageNum first = map->allocate(pg_cnt);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, pg_cnt * PAGE_SIZE);
+    memset(buffer, 1, pg_cnt * PAGE_SIZE);
+    ck_assert_int_eq(pfile->write_pages(first, pg_cnt, buffer), 1);
+
+    struct stat before, after;
+    ck_assert_int_eq(stat(test_file.c_str(), &before), 0);
+
+    ck_assert_int_eq(map->release(first, pg_cnt), 1);
+
+    /* the file is the same length, but its storage has been released */
+    ck_assert_int_eq(stat(test_file.c_str(), &after), 0);
+    ck_assert_int_eq(after.st_size, before.st_size);
+    ck_assert_int_lt(after.st_blocks, before.st_blocks);
+
+    ck_assert_int_eq(pfile->read_page(first, buffer), 1);
+    ck_assert_int_eq(*((int *) buffer), 0);
+
+    free(buffer);
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("FreeSpaceMap Unit Testing");
+
+    TCase *alloc = tcase_create("FreeSpaceMap::allocate Testing");
+    tcase_add_test(alloc, t_allocate_release);
+    tcase_add_test(alloc, t_discard);
+    suite_add_tcase(unit, alloc);
+
+    TCase *persist = tcase_create("FreeSpaceMap::flush Testing");
+    tcase_add_test(persist, t_persistence);
+    tcase_add_test(persist, t_multiple_chunks);
+    tcase_add_test(persist, t_checksums);
+    suite_add_tcase(unit, persist);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,260 @@
+/*
+ *  tests/logfile_tests.cpp
+ *
+ *  Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *  Distributed under the Modified BSD License.
+ */
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "psu-io/LogFile.h"
+
+#include <check.h>
+
+using namespace psudb;
+
+std::string log_file = "bin/tests/data/log_file.dat";
+
+
+static LogSeqNum append_int(LogFile *log, int value) {
+    return log->append((const byte *) &value, sizeof(value));
+}
+
+
+START_TEST(t_append_commit)
+{
+    auto log = LogFile::create(log_file, true);
+    ck_assert_ptr_nonnull(log.get());
+    ck_assert_int_eq(log->get_durable_lsn(), 0);
+
+    /* committing an empty log is a no-op */
+    ck_assert_int_eq(log->commit(), 1);
+
+    size_t rec_cnt = 100;
+    std::vector<LogSeqNum> lsns;
+    for (size_t i=0; i<rec_cnt; i++) {
+        lsns.push_back(append_int(log.get(), i));
+        ck_assert_int_ne(lsns.back(), INVALID_LSN);
+    }
+
+    ck_assert_int_eq(log->get_durable_lsn(), 0);
+    ck_assert_int_eq(log->commit(lsns[10]), 1);
+    ck_assert_int_gt(log->get_durable_lsn(), lsns[10]);
+
+    /* records that were already durable need no further IO */
+    auto writes = log->get_stats().snapshot().writes().ops;
+    ck_assert_int_eq(log->commit(lsns[5]), 1);
+    ck_assert_int_eq(log->get_stats().snapshot().writes().ops, writes);
+
+    ck_assert_int_eq(log->commit(), 1);
+
+    size_t i = 0;
+    auto itr = log->start_scan();
+    while (itr->next()) {
+        ck_assert_int_eq(itr->get_lsn(), lsns[i]);
+        ck_assert_int_eq(itr->get_length(), sizeof(int));
+        ck_assert_int_eq(*((int *) itr->get_item()), i);
+        i++;
+    }
+    ck_assert_int_eq(i, rec_cnt);
+
+    /* empty and oversized records are rejected */
+    ck_assert_int_eq(log->append(nullptr, 0), INVALID_LSN);
+    std::vector<byte> big(DEFAULT_LOG_BUFFER_SIZE);
+    ck_assert_int_eq(log->append(big.data(), big.size()), INVALID_LSN);
+}
+END_TEST
+
+
+START_TEST(t_buffer_overflow)
+{
+    /* records spanning several buffers' worth of data */
+    auto log = LogFile::create(log_file, true, true, 4096);
+    ck_assert_ptr_nonnull(log.get());
+
+    size_t rec_cnt = 500;
+    std::vector<byte> rec(100);
+    for (size_t i=0; i<rec_cnt; i++) {
+        memset(rec.data(), i % 256, rec.size());
+        ck_assert_int_ne(log->append(rec.data(), rec.size()), INVALID_LSN);
+    }
+    ck_assert_int_eq(log->commit(), 1);
+
+    size_t i = 0;
+    auto itr = log->start_scan();
+    while (itr->next()) {
+        ck_assert_int_eq(itr->get_length(), rec.size());
+        ck_assert_int_eq((int) itr->get_item()[rec.size() - 1], i % 256);
+        i++;
+    }
+    ck_assert_int_eq(i, rec_cnt);
+}
+END_TEST
+
+
+START_TEST(t_recovery)
+{
+    size_t rec_cnt = 77;
+    LogSeqNum end;
+
+    {
+        auto log = LogFile::create(log_file, true);
+        for (size_t i=0; i<rec_cnt; i++) {
+            append_int(log.get(), i);
+        }
+        ck_assert_int_eq(log->commit(), 1);
+        end = log->get_durable_lsn();
+
+        /* uncommitted records are lost */
+        append_int(log.get(), -1);
+    }
+
+    /* simulate a torn write, leaving a partial record after the log */
+    int fd = open(log_file.c_str(), O_WRONLY);
+    LogRecordHeader torn = {12345, 100};
+    ck_assert_int_eq(pwrite(fd, &torn, sizeof(torn), end), sizeof(torn));
+    close(fd);
+
+    auto log = LogFile::create(log_file, false);
+    ck_assert_ptr_nonnull(log.get());
+    ck_assert_int_eq(log->get_durable_lsn(), end);
+
+    /* appends continue from the end of the intact records */
+    ck_assert_int_eq(append_int(log.get(), rec_cnt), end);
+    ck_assert_int_eq(log->commit(), 1);
+    log.reset();
+
+    log = LogFile::create(log_file, false);
+    size_t i = 0;
+    auto itr = log->start_scan();
+    while (itr->next()) {
+        ck_assert_int_eq(*((int *) itr->get_item()), i);
+        i++;
+    }
+    ck_assert_int_eq(i, rec_cnt + 1);
+}
+END_TEST
+
+
+START_TEST(t_corruption)
+{
+    LogSeqNum corrupt_lsn = INVALID_LSN;
+    {
+        auto log = LogFile::create(log_file, true);
+        for (size_t i=0; i<10; i++) {
+            LogSeqNum lsn = append_int(log.get(), i);
+            if (i == 6) corrupt_lsn = lsn;
+        }
+        ck_assert_int_eq(log->commit(), 1);
+    }
+
+    /* flip a byte of the payload of the seventh record */
+    int fd = open(log_file.c_str(), O_RDWR);
+    char c;
+    ck_assert_int_eq(pread(fd, &c, 1, corrupt_lsn + sizeof(LogRecordHeader)), 1);
+    c ^= 0xFF;
+    ck_assert_int_eq(pwrite(fd, &c, 1, corrupt_lsn + sizeof(LogRecordHeader)), 1);
+    close(fd);
+
+    auto log = LogFile::create(log_file, false);
+    ck_assert_ptr_nonnull(log.get());
+    ck_assert_int_eq(log->get_durable_lsn(), corrupt_lsn);
+
+    size_t i = 0;
+    auto itr = log->start_scan();
+    while (itr->next()) {
+        i++;
+    }
+    ck_assert_int_eq(i, 6);
+}
+END_TEST
+
+
+START_TEST(t_group_commit)
+{
+    auto log = LogFile::create(log_file, true);
+    ck_assert_ptr_nonnull(log.get());
+
+    size_t thread_cnt = 8;
+    size_t rec_cnt = 200;
+    std::vector<std::thread> threads;
+
+    for (size_t i=0; i<thread_cnt; i++) {
+        threads.emplace_back([&, i]() {
+            for (size_t j=0; j<rec_cnt; j++) {
+                LogSeqNum lsn = append_int(log.get(), i * rec_cnt + j);
+                ck_assert_int_ne(lsn, INVALID_LSN);
+                ck_assert_int_eq(log->commit(lsn), 1);
+                ck_assert_int_gt(log->get_durable_lsn(), lsn);
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    /* every record is present exactly once */
+    std::vector<bool> seen(thread_cnt * rec_cnt, false);
+    auto itr = log->start_scan();
+    while (itr->next()) {
+        int val = *((int *) itr->get_item());
+        ck_assert(!seen[val]);
+        seen[val] = true;
+    }
+
+    for (auto s : seen) {
+        ck_assert(s);
+    }
+
+    /* commits were shared, rather than syncing once per record */
+    auto stats = log->get_stats().snapshot();
+    ck_assert_int_le(stats.writes().ops, thread_cnt * rec_cnt);
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("LogFile Unit Testing");
+
+    TCase *append = tcase_create("LogFile::append Testing");
+    tcase_add_test(append, t_append_commit);
+    tcase_add_test(append, t_buffer_overflow);
+    suite_add_tcase(unit, append);
+
+    TCase *recovery = tcase_create("LogFile recovery Testing");
+    tcase_add_test(recovery, t_recovery);
+    tcase_add_test(recovery, t_corruption);
+    suite_add_tcase(unit, recovery);
+
+    TCase *group = tcase_create("LogFile::commit Concurrency Testing");
+    tcase_add_test(group, t_group_commit);
+    tcase_set_timeout(group, 100);
+    suite_add_tcase(unit, group);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
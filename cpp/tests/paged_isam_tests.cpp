@@ -0,0 +1,253 @@
+/*
+ *  tests/paged_isam_tests.cpp
+ *
+ *  Copyright (C) 2023-2024 Douglas B. Rumbaugh <doug@douglasrumbaugh.com>
+ *  Distributed under the Modified BSD License.
+ */
+
+#include "psu-ds/PagedISAM.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+/* WARNING: due to #define issues, must include this header LAST in C++ projects */
+#include <check.h>
+
+typedef int64_t key_type;
+typedef int64_t val_type;
+typedef std::pair<key_type, val_type> record_t;
+typedef psudb::PagedISAMTree<key_type, val_type> isam_t;
+
+std::string test_file = "bin/tests/data/paged_isam_file.dat";
+
+
+static size_t count_in_range(std::vector<record_t> &sorted, key_type lower, key_type upper) {
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), record_t{lower, INT64_MIN});
+    auto last = std::lower_bound(sorted.begin(), sorted.end(), record_t{upper, INT64_MIN});
+    return last - first;
+}
+
+
+START_TEST(t_build)
+{
+    auto pfile = psudb::PagedFile::create(test_file, true);
+
+    size_t n = 100000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) rand(), i});
+    }
+
+    auto isam = isam_t::build(pfile.get(), records);
+    ck_assert_ptr_nonnull(isam.get());
+    ck_assert_int_eq(isam->record_count(), n);
+
+    /* 255 records per leaf, and a fanout of 340 */
+    ck_assert_int_eq(isam->leaf_count(), 393);
+    ck_assert_int_eq(isam->internal_node_count(), 3);
+    ck_assert_int_eq(isam->height(), 3);
+    ck_assert_int_eq(pfile->get_page_count(), 1 + 393 + 3);
+
+    isam_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+    auto result = isam->query(&q);
+    ck_assert_int_eq(result.size(), n);
+    ck_assert(std::is_sorted(result.begin(), result.end()));
+}
+END_TEST
+
+
+START_TEST(t_build_empty)
+{
+    auto pfile = psudb::PagedFile::create(test_file, true);
+    std::vector<record_t> records;
+
+    auto isam = isam_t::build(pfile.get(), records, true);
+    ck_assert_ptr_nonnull(isam.get());
+    ck_assert_int_eq(isam->record_count(), 0);
+    ck_assert_int_eq(isam->height(), 0);
+
+    isam_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+    ck_assert_int_eq(isam->query(&q).size(), 0);
+
+    record_t r;
+    ck_assert_int_eq(isam->lower_bound(0, &r), 0);
+}
+END_TEST
+
+
+START_TEST(t_build_oneleaf)
+{
+    auto pfile = psudb::PagedFile::create(test_file, true);
+
+    std::vector<record_t> records;
+    for (size_t i=0; i<100; i++) {
+        records.push_back({2 * i, i});
+    }
+
+    auto isam = isam_t::build(pfile.get(), records);
+    ck_assert_int_eq(isam->leaf_count(), 1);
+    ck_assert_int_eq(isam->internal_node_count(), 0);
+    ck_assert_int_eq(isam->height(), 1);
+
+    record_t r;
+    ck_assert_int_eq(isam->lower_bound(51, &r), 1);
+    ck_assert_int_eq(r.first, 52);
+    ck_assert_int_eq(isam->lower_bound(199, &r), 0);
+}
+END_TEST
+
+
+START_TEST(t_query)
+{
+    auto pfile = psudb::PagedFile::create(test_file, true);
+
+    size_t n = 200000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) (rand() % 100000), i});
+    }
+
+    auto isam = isam_t::build(pfile.get(), records);
+    ck_assert_ptr_nonnull(isam.get());
+
+    for (size_t i=0; i<200; i++) {
+        key_type lower = rand() % 100000;
+        key_type upper = lower + rand() % 5000;
+
+        isam_t::RangeQueryParameters q;
+        q.lower_bound = lower;
+        q.upper_bound = upper;
+        auto result = isam->query(&q);
+
+        ck_assert_int_eq(result.size(), count_in_range(records, lower, upper));
+        for (auto &r : result) {
+            ck_assert(r.first >= lower && r.first < upper);
+        }
+
+        /* with duplicate keys, the lower bound is the first copy */
+        record_t r;
+        auto expected = std::lower_bound(records.begin(), records.end(), record_t{lower, INT64_MIN});
+        if (expected == records.end()) {
+            ck_assert_int_eq(isam->lower_bound(lower, &r), 0);
+        } else {
+            ck_assert_int_eq(isam->lower_bound(lower, &r), 1);
+            ck_assert_int_eq(r.first, expected->first);
+            ck_assert_int_eq(r.second, expected->second);
+        }
+    }
+}
+END_TEST
+
+
+START_TEST(t_io_per_level)
+{
+    auto pfile = psudb::PagedFile::create(test_file, true);
+
+    std::vector<record_t> records;
+    for (size_t i=0; i<100000; i++) {
+        records.push_back({i, i});
+    }
+
+    auto isam = isam_t::build(pfile.get(), records);
+    record_t r;
+
+    auto before = pfile->get_stats().snapshot().reads().ops;
+    ck_assert_int_eq(isam->lower_bound(54321, &r), 1);
+    ck_assert_int_eq(r.second, 54321);
+    ck_assert_int_eq(pfile->get_stats().snapshot().reads().ops - before, isam->height());
+
+    /* with the internal levels pinned, only the leaf is read */
+    auto pinned = isam_t::open(pfile.get(), isam->get_meta_page(), true);
+    ck_assert_ptr_nonnull(pinned.get());
+    ck_assert(pinned->is_pinned());
+
+    before = pfile->get_stats().snapshot().reads().ops;
+    ck_assert_int_eq(pinned->lower_bound(12345, &r), 1);
+    ck_assert_int_eq(r.second, 12345);
+    ck_assert_int_eq(pfile->get_stats().snapshot().reads().ops - before, 1);
+}
+END_TEST
+
+
+START_TEST(t_reopen)
+{
+    psudb::PageNum meta;
+    {
+        auto pfile = psudb::PagedFile::create(test_file, true);
+
+        std::vector<record_t> records;
+        for (size_t i=0; i<5000; i++) {
+            records.push_back({i, 5000 - i});
+        }
+
+        auto isam = isam_t::build(pfile.get(), records);
+        meta = isam->get_meta_page();
+    }
+
+    auto pfile = psudb::PagedFile::create(test_file, false);
+    ck_assert_ptr_null(isam_t::open(pfile.get(), meta + 1).get());
+    ck_assert_ptr_null((psudb::PagedISAMTree<int32_t, int32_t>::open(pfile.get(), meta).get()));
+
+    auto isam = isam_t::open(pfile.get(), meta);
+    ck_assert_ptr_nonnull(isam.get());
+    ck_assert_int_eq(isam->record_count(), 5000);
+
+    isam_t::RangeQueryParameters q;
+    q.lower_bound = 1000;
+    q.upper_bound = 1010;
+    auto result = isam->query(&q);
+    ck_assert_int_eq(result.size(), 10);
+    ck_assert_int_eq(result[0].second, 4000);
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("Paged ISAM Tree Unit Testing");
+
+    TCase *build = tcase_create("Paged ISAM Construction Testing");
+    tcase_add_test(build, t_build);
+    tcase_add_test(build, t_build_empty);
+    tcase_add_test(build, t_build_oneleaf);
+    tcase_add_test(build, t_reopen);
+
+    suite_add_tcase(unit, build);
+
+
+    TCase *query = tcase_create("Paged ISAM Query Testing");
+    tcase_add_test(query, t_query);
+    tcase_add_test(query, t_io_per_level);
+
+    tcase_set_timeout(query, 1000);
+    suite_add_tcase(unit, query);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,4 +1,5 @@
 #include <string>
+#include <thread>
 
 #include "psu-io/PagedFile.h"
 #include "psu-io/PagedFileIterator.h"
@@ -72,6 +73,49 @@ START_TEST(t_create_fail)
 END_TEST
 
 
+START_TEST(t_create_page_size)
+{
+    size_t page_size = 16384;
+    auto pfile = PagedFile::create(new_file, true, true, page_size);
+
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert_int_eq(pfile->get_page_size(), page_size);
+    ck_assert_int_eq(pfile->get_file_size(), page_size);
+
+    PageNum page_cnt = 6;
+    ck_assert_int_eq(pfile->allocate_pages(page_cnt), 1);
+    ck_assert_int_eq(pfile->get_page_count(), page_cnt);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, page_cnt * page_size);
+    for (size_t i=0; i<page_cnt; i++) {
+        *((int*) get_page(buffer, i, page_size)) = i + 1;
+    }
+
+    ck_assert_int_eq(pfile->write_pages(1, page_cnt, buffer), 1);
+    memset(buffer, 0, page_cnt * page_size);
+
+    ck_assert_int_eq(pfile->read_page(4, buffer), 1);
+    ck_assert_int_eq(*((int*) buffer), 4);
+
+    size_t i = 0;
+    auto itr = pfile->start_scan(1, 0, 4);
+    while (itr->next()) {
+        ck_assert_int_eq(*((int*) itr->get_item()), ++i);
+    }
+    ck_assert_int_eq(i, page_cnt);
+
+    ck_assert_int_eq(pfile->get_stats().snapshot().writes().pages, page_cnt);
+
+    /* invalid page sizes are rejected */
+    ck_assert_ptr_null(PagedFile::create(new_file, true, true, 3000).get());
+    ck_assert_ptr_null(PagedFile::create(new_file, true, true, 256).get());
+    ck_assert_ptr_null(PagedFile::create(new_file, true, true, 2*MAX_PAGE_SIZE).get());
+
+    free(buffer);
+}
+END_TEST
+
+
 START_TEST(t_create_open)
 {
     size_t pg_cnt = 10;
@@ -139,6 +183,53 @@ START_TEST(t_read_pages_sg)
 END_TEST
 
 
+START_TEST(t_read_pages_coalesce)
+{
+    size_t pg_cnt = 2500;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    /*
+     * Read every other page, so that every page is coalesced with its
+     * neighbor, and the batch needs more than IOV_MAX iovecs.
+     */
+    size_t buf_cnt = pg_cnt / 2;
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE * buf_cnt);
+    std::vector<std::pair<PageNum, byte*>> reads(buf_cnt);
+    for (size_t i=0; i<buf_cnt; i++) {
+        reads[i] = {2 * (buf_cnt - i) - 1, buffer + PAGE_SIZE * i};
+    }
+
+    IOVecArena arena;
+    for (PageNum gap : {0, 1, 4}) {
+        memset(buffer, 0, PAGE_SIZE * buf_cnt);
+        ck_assert_int_eq(pfile->read_pages(reads, arena, gap), 1);
+
+        for (size_t i=0; i<buf_cnt; i++) {
+            ck_assert_int_eq(*((int*) (buffer + PAGE_SIZE * i)), 2 * (buf_cnt - i) - 1);
+        }
+    }
+
+    /* a single page, duplicate pages, and out-of-range pages */
+    std::vector<std::pair<PageNum, byte*>> single = {{7, buffer}};
+    ck_assert_int_eq(pfile->read_pages(single, arena), 1);
+    ck_assert_int_eq(*((int*) buffer), 7);
+
+    std::vector<std::pair<PageNum, byte*>> dups = {{9, buffer}, {9, buffer + PAGE_SIZE}, {10, buffer + 2*PAGE_SIZE}};
+    ck_assert_int_eq(pfile->read_pages(dups, arena), 1);
+    for (size_t i=0; i<3; i++) {
+        ck_assert_int_eq(*((int*) (buffer + PAGE_SIZE * i)), (i < 2) ? 9 : 10);
+    }
+
+    std::vector<std::pair<PageNum, byte*>> invalid = {{3, buffer}, {pg_cnt + 1, buffer + PAGE_SIZE}};
+    ck_assert_int_eq(pfile->read_pages(invalid, arena), 0);
+
+    free(buffer);
+}
+END_TEST
+
+
 START_TEST(t_read_pages_seq)
 {
     size_t pg_cnt = 20;
@@ -163,6 +254,47 @@ START_TEST(t_read_pages_seq)
 }
 END_TEST
 
+START_TEST(t_mapped)
+{
+    size_t pg_cnt = 20;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+
+    ck_assert_ptr_null(PagedFile::create_mapped(nonexisting_file).get());
+
+    auto pfile = PagedFile::create_mapped(existing_file1);
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert(pfile->is_mapped());
+    ck_assert_int_eq(pfile->get_page_count(), pg_cnt);
+
+    for (size_t i=1; i<=pg_cnt; i++) {
+        const byte *page = pfile->view_page(i);
+        ck_assert_ptr_nonnull(page);
+        ck_assert_int_eq(*((int *) page), i);
+    }
+
+    ck_assert_ptr_null(pfile->view_page(0));
+    ck_assert_ptr_null(pfile->view_page(pg_cnt + 1));
+
+    ck_assert_int_eq(pfile->advise(ADVISE_SEQUENTIAL), 1);
+
+    /* the copying interface continues to work */
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE*5);
+    ck_assert_int_eq(pfile->read_page(3, buffer), 1);
+    ck_assert_int_eq(*((int *) buffer), 3);
+    ck_assert_int_eq(pfile->read_pages(6, 5, buffer), 1);
+    for (size_t i=0; i<5; i++) {
+        ck_assert_int_eq(*((int *) (buffer + PAGE_SIZE * i)), i + 6);
+    }
+
+    /* but the file is read-only */
+    ck_assert_int_eq(pfile->write_page(1, buffer), 0);
+    ck_assert_int_eq(pfile->allocate_pages(1), INVALID_PNUM);
+
+    free(buffer);
+}
+END_TEST
+
+
 START_TEST(t_allocate_pages)
 {
     auto pfile = PagedFile::create(new_file, true);
@@ -180,6 +312,68 @@ START_TEST(t_allocate_pages)
 }
 END_TEST
 
+START_TEST(t_allocate_pages_concurrent)
+{
+    auto pfile = PagedFile::create(new_file, true);
+    ck_assert_ptr_nonnull(pfile.get());
+    pfile->set_preallocation(64);
+
+    size_t thread_cnt = 8;
+    size_t alloc_cnt = 50;
+    std::vector<std::vector<PageNum>> firsts(thread_cnt);
+    std::vector<std::thread> threads;
+
+    for (size_t i=0; i<thread_cnt; i++) {
+        threads.emplace_back([&, i]() {
+            byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE);
+            *((int*) buffer) = i;
+
+            for (size_t j=0; j<alloc_cnt; j++) {
+                PageNum pnum = pfile->allocate_pages(2);
+                firsts[i].push_back(pnum);
+                pfile->write_page(pnum, buffer);
+                pfile->write_page(pnum + 1, buffer);
+            }
+
+            free(buffer);
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    ck_assert_int_eq(pfile->get_page_count(), thread_cnt * alloc_cnt * 2);
+
+    /* every allocation received a distinct range, and kept its contents */
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE);
+    std::vector<PageNum> all;
+    for (size_t i=0; i<thread_cnt; i++) {
+        for (auto pnum : firsts[i]) {
+            ck_assert_int_ne(pnum, INVALID_PNUM);
+            ck_assert_int_eq(pfile->read_page(pnum + 1, buffer), 1);
+            ck_assert_int_eq(*((int*) buffer), i);
+            all.push_back(pnum);
+        }
+    }
+
+    std::sort(all.begin(), all.end());
+    for (size_t i=0; i<all.size(); i++) {
+        ck_assert_int_eq(all[i], 2*i + 1);
+    }
+
+    /* preallocated space is released on close */
+    pfile->set_preallocation(100);
+    pfile->allocate_pages(1);
+    pfile.reset();
+
+    pfile = PagedFile::create(new_file, false);
+    ck_assert_int_eq(pfile->get_page_count(), thread_cnt * alloc_cnt * 2 + 1);
+
+    free(buffer);
+}
+END_TEST
+
 START_TEST(t_write)
 {
     auto pfile = PagedFile::create(new_file, true);
@@ -304,6 +498,360 @@ START_TEST(t_iterator_page_range)
 END_TEST
 
 
+START_TEST(t_iterator_batched)
+{
+    size_t pg_cnt = 23;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    for (size_t batch_size : {1, 4, 5, 23, 50}) {
+        auto iter = pfile->start_scan(1, 0, batch_size);
+        ck_assert_ptr_nonnull(iter.get());
+
+        size_t i=0;
+        while (iter->next()) {
+            i++;
+            ck_assert_int_eq(i, *((int*) iter->get_item()));
+        }
+
+        ck_assert_int_eq(i, pg_cnt);
+    }
+
+    auto iter = pfile->start_scan(5, 13, 4);
+    size_t i=4;
+    while (iter->next()) {
+        i++;
+        ck_assert_int_eq(i, *((int*) iter->get_item()));
+    }
+
+    ck_assert_int_eq(i, 13);
+}
+END_TEST
+
+
+START_TEST(t_iterator_readahead)
+{
+    size_t pg_cnt = 100;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert_int_eq(pfile->enable_async_io(8), 1);
+
+    for (size_t batch_cnt : {1, 2, 4, 16}) {
+        auto iter = pfile->start_scan(1, 0, 8, batch_cnt);
+        ck_assert_ptr_nonnull(iter.get());
+
+        size_t i=0;
+        while (iter->next()) {
+            i++;
+            ck_assert_int_eq(i, *((int*) iter->get_item()));
+        }
+
+        ck_assert_int_eq(i, pg_cnt);
+    }
+
+    /* destroying a partially consumed scan must not leave reads in flight */
+    auto iter = pfile->start_scan(10, 90, 8, 4);
+    ck_assert(iter->next());
+    ck_assert_int_eq(10, *((int*) iter->get_item()));
+    iter.reset();
+}
+END_TEST
+
+
+START_TEST(t_async_read)
+{
+    size_t pg_cnt = 20;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE*pg_cnt);
+
+    /* async IO must be enabled before use */
+    ck_assert_int_eq(pfile->async_read_page(1, buffer), INVALID_IOTOKEN);
+    ck_assert_int_eq(pfile->enable_async_io(8), 1);
+    ck_assert(pfile->supports_async_io());
+
+    std::vector<IOToken> tokens;
+    for (size_t i=0; i<pg_cnt; i++) {
+        auto tok = pfile->async_read_page(i + 1, buffer + PAGE_SIZE * i);
+        ck_assert_int_ne(tok, INVALID_IOTOKEN);
+        tokens.push_back(tok);
+    }
+
+    ck_assert_int_eq(pfile->async_read_page(0, buffer), INVALID_IOTOKEN);
+    ck_assert_int_eq(pfile->async_read_page(pg_cnt + 1, buffer), INVALID_IOTOKEN);
+
+    ck_assert_int_ge(pfile->async_submit(), 0);
+    for (size_t i=0; i<pg_cnt; i++) {
+        ck_assert_int_eq(pfile->async_wait(tokens[i]), IO_SUCCESS);
+        ck_assert_int_eq(*((int *) (buffer + PAGE_SIZE * i)), i + 1);
+    }
+
+    /* a token is released once its result has been retrieved */
+    ck_assert_int_eq(pfile->async_poll(tokens[0]), IO_FAILED);
+
+    auto tok = pfile->async_read_pages(5, 10, buffer);
+    ck_assert_int_ne(tok, INVALID_IOTOKEN);
+    pfile->async_submit();
+
+    IOStatus stat;
+    while ((stat = pfile->async_poll(tok)) == IO_PENDING)
+        ;
+
+    ck_assert_int_eq(stat, IO_SUCCESS);
+    for (size_t i=0; i<10; i++) {
+        ck_assert_int_eq(*((int *) (buffer + PAGE_SIZE * i)), i + 5);
+    }
+
+    free(buffer);
+}
+END_TEST
+
+
+START_TEST(t_async_read_pages_sg)
+{
+    size_t pg_cnt = 20;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert_int_eq(pfile->enable_async_io(), 1);
+
+    size_t buf_cnt = 10;
+    std::vector<byte *> buffers(buf_cnt);
+    std::vector<std::pair<PageNum, byte*>> reads(buf_cnt);
+    std::vector<PageNum> to_read = {1, 2, 3, 5, 9, 7, 8, 11, 12, 15};
+    for (size_t i=0; i<buf_cnt; i++) {
+        buffers[i] = (byte *) std::aligned_alloc(SECTOR_SIZE, PAGE_SIZE); 
+        reads[i] = {to_read[i], buffers[i]};
+    }
+
+    auto tok = pfile->async_read_pages(reads);
+    ck_assert_int_ne(tok, INVALID_IOTOKEN);
+    ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+
+    for (size_t i=0; i<buf_cnt; i++) {
+        ck_assert_int_eq(*((int*) buffers[i]), to_read[i]);
+    }
+
+    reads.push_back({pg_cnt + 1, buffers[0]});
+    ck_assert_int_eq(pfile->async_read_pages(reads), INVALID_IOTOKEN);
+
+    for (size_t i=0; i<buf_cnt; i++) {
+        free(buffers[i]);
+    }
+}
+END_TEST
+
+
+START_TEST(t_async_read_pages_long_run)
+{
+    /* a run of adjacent pages longer than IOV_MAX must be split */
+    size_t pg_cnt = 2 * IOV_MAX + 100;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert_int_eq(pfile->enable_async_io(), 1);
+
+    byte *buffer = (byte *) std::aligned_alloc(SECTOR_SIZE, PAGE_SIZE * pg_cnt);
+    std::vector<std::pair<PageNum, byte*>> reads(pg_cnt);
+    for (size_t i=0; i<pg_cnt; i++) {
+        reads[i] = {i + 1, buffer + PAGE_SIZE * i};
+    }
+
+    auto tok = pfile->async_read_pages(reads);
+    ck_assert_int_ne(tok, INVALID_IOTOKEN);
+    ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+
+    for (size_t i=0; i<pg_cnt; i++) {
+        ck_assert_int_eq(*((int*) (buffer + PAGE_SIZE * i)), i + 1);
+    }
+
+    free(buffer);
+}
+END_TEST
+
+
+START_TEST(t_async_write)
+{
+    auto pfile = PagedFile::create(new_file, true);
+    ck_assert_ptr_nonnull(pfile.get());
+    ck_assert_int_eq(pfile->enable_async_io(4), 1);
+
+    PageNum page_cnt = 13;
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, page_cnt*PAGE_SIZE);
+    for (size_t i=0; i<page_cnt; i++) {
+        *((int*) (buffer + PAGE_SIZE * i)) = i;
+    }
+
+    ck_assert_int_eq(pfile->async_write_pages(1, page_cnt, buffer), INVALID_IOTOKEN);
+    pfile->allocate_pages(2 * page_cnt);
+
+    /* more requests than the queue depth, forcing completions to be reaped */
+    std::vector<IOToken> tokens;
+    for (size_t i=0; i<page_cnt; i++) {
+        tokens.push_back(pfile->async_write_page(i + 1, buffer + PAGE_SIZE * i));
+        ck_assert_int_ne(tokens[i], INVALID_IOTOKEN);
+    }
+
+    auto tok = pfile->async_write_pages(page_cnt + 1, page_cnt, buffer);
+    ck_assert_int_ne(tok, INVALID_IOTOKEN);
+
+    for (size_t i=0; i<page_cnt; i++) {
+        ck_assert_int_eq(pfile->async_wait(tokens[i]), IO_SUCCESS);
+    }
+    ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+
+    byte *buffer2 = (byte *) aligned_alloc(SECTOR_SIZE, 2*page_cnt*PAGE_SIZE);
+    ck_assert_int_eq(pfile->read_pages(1, 2 * page_cnt, buffer2), 1);
+    for (size_t i=0; i<2*page_cnt; i++) {
+        ck_assert_int_eq(*((int*) (buffer2 + PAGE_SIZE * i)), i % page_cnt);
+    }
+
+    free(buffer);
+    free(buffer2);
+}
+END_TEST
+
+
+START_TEST(t_stats)
+{
+    size_t pg_cnt = 20;
+    ck_assert(initialize_test_file(existing_file1, pg_cnt));
+
+    IOStatsRegistry::get().reset();
+
+    auto pfile = PagedFile::create(existing_file1, false);
+    ck_assert_ptr_nonnull(pfile.get());
+
+    auto stats = pfile->get_stats().snapshot();
+    ck_assert_int_eq(stats.reads().ops, 0);
+    ck_assert_int_eq(stats.writes().ops, 0);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE*10);
+    ck_assert_int_eq(pfile->read_page(1, buffer), 1);
+    ck_assert_int_eq(pfile->read_pages(2, 5, buffer), 1);
+    ck_assert_int_eq(pfile->read_page(0, buffer), 0);
+    ck_assert_int_eq(pfile->write_pages(3, 2, buffer), 1);
+
+    stats = pfile->get_stats().snapshot();
+    ck_assert_int_eq(stats.reads().ops, 2);
+    ck_assert_int_eq(stats.reads().pages, 6);
+    ck_assert_int_eq(stats.reads().bytes, 6 * PAGE_SIZE);
+    ck_assert_int_eq(stats.reads().syscalls, 2);
+    ck_assert_int_eq(stats.writes().ops, 1);
+    ck_assert_int_eq(stats.writes().pages, 2);
+
+    uint64_t hist_total = 0;
+    for (auto cnt : stats.reads().latency_hist) hist_total += cnt;
+    ck_assert_int_eq(hist_total, 2);
+    ck_assert_int_gt(stats.reads().latency_percentile(1.0), 0);
+
+    ck_assert_int_eq(pfile->enable_async_io(), 1);
+    auto tok = pfile->async_read_pages(1, 4, buffer);
+    ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+
+    stats = pfile->get_stats().snapshot();
+    ck_assert_int_eq(stats.reads().ops, 3);
+    ck_assert_int_eq(stats.reads().pages, 10);
+    ck_assert_int_ge(stats.async_submits, 1);
+
+    /* statistics of closed files are retained by the registry */
+    pfile.reset();
+    auto pfile2 = PagedFile::create(existing_file1, false);
+    ck_assert_int_eq(pfile2->read_page(1, buffer), 1);
+
+    auto total = IOStatsRegistry::get().aggregate();
+    ck_assert_int_eq(total.reads().ops, 4);
+    ck_assert_int_eq(total.writes().ops, 1);
+
+    pfile2->get_stats().reset();
+    ck_assert_int_eq(pfile2->get_stats().snapshot().reads().ops, 0);
+
+    free(buffer);
+}
+END_TEST
+
+
+START_TEST(t_checksums)
+{
+    auto pfile = PagedFile::create(new_file, true);
+    ck_assert_ptr_nonnull(pfile.get());
+    pfile->enable_checksums();
+    ck_assert(pfile->has_checksums());
+    ck_assert_int_eq(pfile->get_payload_size(), PAGE_SIZE - sizeof(PageTrailer));
+
+    size_t pg_cnt = 10;
+    pfile->allocate_pages(pg_cnt + 1);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE*pg_cnt);
+    memset(buffer, 0xAB, PAGE_SIZE*pg_cnt);
+    for (size_t i=0; i<pg_cnt; i++) {
+        *((int*) (buffer + PAGE_SIZE * i)) = i + 1;
+    }
+
+    ck_assert_int_eq(pfile->write_pages(1, pg_cnt, buffer), 1);
+
+    /* the caller's buffer is not stamped */
+    ck_assert_int_eq((int) buffer[PAGE_SIZE - 1], 0xAB);
+
+    memset(buffer, 0, PAGE_SIZE*pg_cnt);
+    ck_assert_int_eq(pfile->read_pages(1, pg_cnt, buffer), 1);
+    for (size_t i=0; i<pg_cnt; i++) {
+        ck_assert_int_eq(*((int*) (buffer + PAGE_SIZE * i)), i + 1);
+        ck_assert_int_eq((int) buffer[PAGE_SIZE * i + 100], 0xAB);
+    }
+
+    /* a page which has never been written is valid */
+    ck_assert_int_eq(pfile->read_page(pg_cnt + 1, buffer), 1);
+
+    /* corrupt page 4, and write page 2's contents over page 6 */
+    int fd = open(new_file.c_str(), O_RDWR);
+    char c = 0x12;
+    ck_assert_int_eq(pwrite(fd, &c, 1, 4*PAGE_SIZE + 10), 1);
+    ck_assert_int_eq(pread(fd, buffer, PAGE_SIZE, 2*PAGE_SIZE), PAGE_SIZE);
+    ck_assert_int_eq(pwrite(fd, buffer, PAGE_SIZE, 6*PAGE_SIZE), PAGE_SIZE);
+    close(fd);
+
+    ck_assert_int_eq(pfile->read_page(3, buffer), 1);
+    ck_assert_int_eq(pfile->read_page(4, buffer), 0);
+    ck_assert_int_eq(pfile->read_page(6, buffer), 0);
+    ck_assert_int_eq(pfile->read_pages(1, 5, buffer), 0);
+    ck_assert_int_ge(pfile->get_stats().snapshot().checksum_failures, 3);
+
+    std::vector<std::pair<PageNum, byte*>> reads = {{8, buffer}, {4, buffer + PAGE_SIZE}};
+    ck_assert_int_eq(pfile->read_pages(reads), 0);
+
+    /* scans stop at the corrupted page */
+    size_t scanned = 0;
+    auto itr = pfile->start_scan(1, pg_cnt);
+    while (itr->next()) {
+        scanned++;
+    }
+    ck_assert_int_eq(scanned, 3);
+    itr.reset();
+
+    if (pfile->enable_async_io()) {
+        auto tok = pfile->async_read_pages(3, 2, buffer);
+        ck_assert_int_eq(pfile->async_wait(tok), IO_FAILED);
+
+        /* async writes are stamped, and repair the page */
+        *((int*) buffer) = 44;
+        tok = pfile->async_write_page(4, buffer);
+        ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+
+        tok = pfile->async_read_pages(3, 2, buffer);
+        ck_assert_int_eq(pfile->async_wait(tok), IO_SUCCESS);
+        ck_assert_int_eq(*((int*) (buffer + PAGE_SIZE)), 44);
+    }
+
+    free(buffer);
+}
+END_TEST
+
+
 Suite *unit_testing()
 {
     Suite *unit = suite_create("PagedFile Unit Testing");
@@ -311,16 +859,20 @@ Suite *unit_testing()
     tcase_add_test(initialize, t_create);
     tcase_add_test(initialize, t_create_fail);
     tcase_add_test(initialize, t_create_open);
+    tcase_add_test(initialize, t_create_page_size);
     suite_add_tcase(unit, initialize);
 
     TCase *read = tcase_create("PagedFile::read_page(s) Testing");
     tcase_add_test(read, t_read_page);
     tcase_add_test(read, t_read_pages_sg);
     tcase_add_test(read, t_read_pages_seq);
+    tcase_add_test(read, t_read_pages_coalesce);
+    tcase_add_test(read, t_mapped);
     suite_add_tcase(unit, read);
 
     TCase *allocate = tcase_create("PagedFile::allocate_pages Testing");
     tcase_add_test(allocate, t_allocate_pages);
+    tcase_add_test(allocate, t_allocate_pages_concurrent);
     suite_add_tcase(unit, allocate);
 
     TCase *write = tcase_create("PagedFile::write_page(s) Testing");
@@ -335,8 +887,25 @@ Suite *unit_testing()
     TCase *iter = tcase_create("PagedFile::start_scan Testing");
     tcase_add_test(iter, t_iterator);
     tcase_add_test(iter, t_iterator_page_range);
+    tcase_add_test(iter, t_iterator_batched);
+    tcase_add_test(iter, t_iterator_readahead);
     suite_add_tcase(unit, iter);
 
+    TCase *async = tcase_create("PagedFile::async IO Testing");
+    tcase_add_test(async, t_async_read);
+    tcase_add_test(async, t_async_read_pages_sg);
+    tcase_add_test(async, t_async_read_pages_long_run);
+    tcase_add_test(async, t_async_write);
+    suite_add_tcase(unit, async);
+
+    TCase *stats = tcase_create("PagedFile::get_stats Testing");
+    tcase_add_test(stats, t_stats);
+    suite_add_tcase(unit, stats);
+
+    TCase *checksums = tcase_create("PagedFile::enable_checksums Testing");
+    tcase_add_test(checksums, t_checksums);
+    suite_add_tcase(unit, checksums);
+
     return unit;
 }
 
@@ -0,0 +1,351 @@
+/*
+ *  tests/pgm_index_tests.cpp
+ *
+ *  Copyright (C) 2023-2024 Douglas B. Rumbaugh <doug@douglasrumbaugh.com>
+ *  Distributed under the Modified BSD License.
+ */
+
+#include "psu-ds/PGMIndex.h"
+#include "psu-ds/StaticISAM.h"
+#include "psu-util/bentley-saxe.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+/* WARNING: due to #define issues, must include this header LAST in C++ projects */
+#include <check.h>
+
+typedef int64_t key_type;
+typedef int64_t val_type;
+typedef std::pair<key_type, val_type> record_t;
+typedef psudb::PGMIndex<key_type, val_type> pgm_t;
+
+static_assert(psudb::bsm::BentleyInterface<pgm_t, record_t>);
+static_assert(psudb::bsm::MergeBuildInterface<pgm_t, record_t>);
+
+
+START_TEST(t_build)
+{
+    size_t n = 10000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) rand(), i});
+    }
+
+    auto pgm = pgm_t::build(records);
+    ck_assert_int_eq(pgm->record_count(), n);
+    ck_assert_int_ge(pgm->segment_count(), 1);
+    ck_assert_int_ge(pgm->height(), 1);
+
+    pgm_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+
+    auto result = pgm->query(&q);
+    ck_assert_int_eq(result.size(), n);
+    ck_assert(std::is_sorted(result.begin(), result.end()));
+
+    auto data = pgm->unbuild();
+    ck_assert_int_eq(data.size(), n);
+    delete pgm;
+}
+END_TEST
+
+
+START_TEST(t_build_empty)
+{
+    std::vector<record_t> records;
+    auto pgm = pgm_t::build(records);
+
+    ck_assert_int_eq(pgm->record_count(), 0);
+    ck_assert_int_eq(pgm->segment_count(), 0);
+    ck_assert_int_eq(pgm->height(), 0);
+    ck_assert_int_eq(pgm->lower_bound(5), 0);
+
+    pgm_t::RangeQueryParameters q;
+    q.lower_bound = 0;
+    q.upper_bound = INT64_MAX;
+    ck_assert_int_eq(pgm->query(&q).size(), 0);
+
+    delete pgm;
+}
+END_TEST
+
+
+START_TEST(t_build_onerec)
+{
+    std::vector<record_t> records = {{10, 1}};
+    auto pgm = pgm_t::build(records);
+
+    ck_assert_int_eq(pgm->segment_count(), 1);
+    ck_assert_int_eq(pgm->height(), 1);
+    ck_assert_int_eq(pgm->lower_bound(5), 0);
+    ck_assert_int_eq(pgm->lower_bound(10), 0);
+    ck_assert_int_eq(pgm->lower_bound(11), 1);
+
+    delete pgm;
+}
+END_TEST
+
+
+START_TEST(t_build_linear)
+{
+    /* evenly spaced keys are covered by a single segment */
+    std::vector<record_t> records;
+    for (size_t i=0; i<100000; i++) {
+        records.push_back({(key_type) (7 * i + 3), i});
+    }
+
+    auto pgm = pgm_t::build_presorted(records);
+    ck_assert_int_eq(pgm->segment_count(), 1);
+    ck_assert_int_eq(pgm->height(), 1);
+
+    for (size_t i=0; i<1000; i++) {
+        key_type key = rand() % 700010;
+        ck_assert_int_eq(pgm->lower_bound(key), std::min<size_t>((std::max<key_type>(key, 0) + 3) / 7, 100000));
+    }
+
+    delete pgm;
+}
+END_TEST
+
+
+template <typename K, size_t EPSILON>
+static void check_key_type(K range)
+{
+    typedef psudb::PGMIndex<K, int64_t, EPSILON> index_t;
+    std::mt19937_64 rng(EPSILON);
+
+    for (size_t n : {(size_t) 1, (size_t) 5, EPSILON * 3, (size_t) 50000}) {
+        std::vector<std::pair<K, int64_t>> records;
+        std::vector<K> keys;
+        for (size_t i=0; i<n; i++) {
+            /* skewed keys, drawn from a limited space so that there are duplicates */
+            K key = (K) ((double) range * std::pow((double) (rng() % 100000) / 100000.0, 3));
+            records.push_back({key, i});
+            keys.push_back(key);
+        }
+
+        auto pgm = index_t::build(records);
+        std::sort(keys.begin(), keys.end());
+
+        for (size_t i=0; i<500; i++) {
+            K key = (K) ((double) range * std::pow((double) (rng() % 110000) / 100000.0, 3));
+
+            ck_assert_int_eq(pgm->lower_bound(key), std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+        }
+
+        delete pgm;
+    }
+}
+
+
+START_TEST(t_lower_bound_key_types)
+{
+    check_key_type<int32_t, 8>(1000000);
+    check_key_type<uint32_t, 64>(4000000000u);
+    check_key_type<int64_t, 16>(1000000000000);
+    check_key_type<uint64_t, 64>(18000000000000000000ull);
+    check_key_type<float, 8>(1000.0f);
+    check_key_type<double, 32>(1e12);
+}
+END_TEST
+
+
+START_TEST(t_lower_bound_extremes)
+{
+    /* keys spanning the whole key space must not overflow the prediction */
+    std::vector<record_t> records = {{INT64_MIN, 0}, {-5, 1}, {0, 2}, {INT64_MAX - 1, 3}, {INT64_MAX, 4}};
+    for (size_t i=0; i<1000; i++) {
+        records.push_back({(key_type) i * 1000003, i});
+    }
+
+    std::vector<key_type> keys;
+    for (auto &rec : records) {
+        keys.push_back(rec.first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    auto pgm = pgm_t::build(records);
+
+    std::vector<key_type> probes = {INT64_MIN, INT64_MIN + 1, -6, -5, -4, 0, 1, 999, 1000003, INT64_MAX - 2, INT64_MAX - 1, INT64_MAX};
+    for (auto key : probes) {
+        ck_assert_int_eq(pgm->lower_bound(key), std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+    }
+
+    delete pgm;
+}
+END_TEST
+
+
+START_TEST(t_query)
+{
+    size_t n = 200000;
+    std::vector<record_t> records;
+    std::vector<key_type> keys;
+    for (size_t i=0; i<n; i++) {
+        key_type key = rand() % 100000;
+        records.push_back({key, i});
+        keys.push_back(key);
+    }
+
+    auto pgm = pgm_t::build(records);
+    std::sort(keys.begin(), keys.end());
+
+    for (size_t i=0; i<200; i++) {
+        pgm_t::RangeQueryParameters q;
+        q.lower_bound = rand() % 100000;
+        q.upper_bound = q.lower_bound + rand() % 5000;
+
+        auto result = pgm->query(&q);
+        auto first = std::lower_bound(keys.begin(), keys.end(), q.lower_bound);
+        auto last = std::lower_bound(keys.begin(), keys.end(), q.upper_bound);
+
+        ck_assert_int_eq(result.size(), last - first);
+        for (size_t j=0; j<result.size(); j++) {
+            ck_assert_int_eq(result[j].first, *(first + j));
+        }
+    }
+
+    delete pgm;
+}
+END_TEST
+
+
+START_TEST(t_memory)
+{
+    size_t n = 1000000;
+    std::vector<record_t> records;
+    std::mt19937_64 rng(0);
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) (rng() >> 1), i});
+    }
+
+    auto copy = records;
+    auto pgm = pgm_t::build(copy);
+    auto isam = psudb::ISAMTree<key_type, val_type, 64>::build(records);
+
+    /* uniform keys need only a handful of segments */
+    ck_assert_int_lt(pgm->segment_count(), n / 1000);
+    ck_assert_int_lt(pgm->index_memory_usage() * 10, isam->index_memory_usage());
+
+    delete pgm;
+    delete isam;
+}
+END_TEST
+
+
+START_TEST(t_build_from_runs)
+{
+    std::vector<record_t> records;
+    std::vector<std::vector<record_t>> runs(5);
+    for (size_t i=0; i<50000; i++) {
+        record_t rec = {(key_type) (rand() % 100000), i};
+        records.push_back(rec);
+        runs[i % 3].push_back(rec);
+    }
+
+    for (auto &run : runs) {
+        std::sort(run.begin(), run.end());
+    }
+
+    auto pgm = pgm_t::build(records);
+    auto merged = pgm_t::build_from_runs(runs);
+
+    ck_assert_int_eq(merged->record_count(), pgm->record_count());
+    for (size_t i=0; i<merged->record_count(); i++) {
+        ck_assert(*merged->get_record_at(i) == *pgm->get_record_at(i));
+    }
+
+    for (auto &run : runs) {
+        ck_assert_int_eq(run.size(), 0);
+    }
+
+    delete pgm;
+    delete merged;
+}
+END_TEST
+
+
+START_TEST(t_bentley_saxe)
+{
+    auto bs = psudb::bsm::BentleySaxe<record_t, pgm_t>();
+
+    std::vector<key_type> keys;
+    for (size_t i=0; i<10000; i++) {
+        keys.push_back(i);
+    }
+
+    std::mt19937 rng(0);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    for (size_t i=0; i<keys.size(); i++) {
+        record_t rec = {keys[i], i};
+        bs.insert(rec);
+    }
+
+    ck_assert_int_eq(bs.record_count(), keys.size());
+
+    for (size_t i=0; i<100; i++) {
+        pgm_t::RangeQueryParameters parm;
+        parm.lower_bound = rand() % 10000;
+        parm.upper_bound = parm.lower_bound + rand() % 1000;
+
+        auto res = bs.query(&parm);
+        ck_assert_int_eq(res.size(), std::min<key_type>(parm.upper_bound, 10000) - parm.lower_bound);
+    }
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("PGM Index Unit Testing");
+
+    TCase *build = tcase_create("PGM Index Construction Testing");
+    tcase_add_test(build, t_build);
+    tcase_add_test(build, t_build_empty);
+    tcase_add_test(build, t_build_onerec);
+    tcase_add_test(build, t_build_linear);
+    tcase_add_test(build, t_build_from_runs);
+
+    suite_add_tcase(unit, build);
+
+
+    TCase *query = tcase_create("PGM Index Query Testing");
+    tcase_add_test(query, t_lower_bound_key_types);
+    tcase_add_test(query, t_lower_bound_extremes);
+    tcase_add_test(query, t_query);
+    tcase_add_test(query, t_memory);
+    tcase_add_test(query, t_bentley_saxe);
+
+    tcase_set_timeout(query, 1000);
+    suite_add_tcase(unit, query);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
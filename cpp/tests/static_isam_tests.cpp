@@ -288,6 +288,351 @@ START_TEST(t_query)
 }
 END_TEST
 
+/*
+ * Check range queries against a sorted copy of the keys, for a variety of
+ * key types and fanouts exercising each of the internal node and leaf
+ * search paths.
+ */
+START_TEST(t_range)
+{
+    size_t n = 100000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) (rand() % 50000), i});
+    }
+
+    auto isam = psudb::ISAMTree<key_type, val_type, 64>::build(records);
+
+    for (size_t i=0; i<100; i++) {
+        key_type lower = rand() % 52000;
+        key_type upper = lower + rand() % 1000;
+
+        psudb::ISAMTree<key_type, val_type, 64>::RangeQueryParameters q;
+        q.lower_bound = lower;
+        q.upper_bound = upper;
+        auto expected = isam->query(&q);
+
+        /* the view points directly into the tree's records */
+        auto view = isam->range(lower, upper);
+        ck_assert_int_eq(view.size(), expected.size());
+        ck_assert(std::equal(view.begin(), view.end(), expected.begin()));
+        if (view.size() > 0) {
+            ck_assert_ptr_eq(view.data(), isam->get_record_at(isam->lower_bound(lower)));
+        }
+
+        std::vector<record_t> visited;
+        size_t cnt = isam->visit_range(lower, upper, [&](const record_t &rec) {
+            visited.push_back(rec);
+            return true;
+        });
+        ck_assert_int_eq(cnt, expected.size());
+        ck_assert(visited == expected);
+
+        /* visiting stops once the visitor returns false */
+        if (expected.size() > 3) {
+            cnt = isam->visit_range(lower, upper, [&](const record_t &rec) {
+                return rec.second != expected[2].second;
+            });
+            ck_assert_int_eq(cnt, 3);
+        }
+    }
+
+    /* an empty or inverted range yields nothing */
+    ck_assert_int_eq(isam->range(100, 100).size(), 0);
+    ck_assert_int_eq(isam->range(200, 100).size(), 0);
+    ck_assert_int_eq(isam->visit_range(200, 100, [](const record_t &) { return true; }), 0);
+
+    delete isam;
+}
+END_TEST
+
+
+template <typename K, size_t FANOUT, psudb::ISAMLayout LAYOUT=psudb::ISAMLayout::EXPLICIT>
+static void check_key_type()
+{
+    typedef psudb::ISAMTree<K, int64_t, FANOUT, LAYOUT> isam_t;
+
+    for (size_t n : {(size_t) 1, (size_t) 5, FANOUT, FANOUT * FANOUT + 3, (size_t) 20000}) {
+        std::vector<std::pair<K, int64_t>> records;
+        std::vector<K> keys;
+        for (size_t i=0; i<n; i++) {
+            /* a small key space, so that there are duplicates */
+            K key = (K) (rand() % 5000);
+            if constexpr (std::is_signed_v<K>) {
+                key -= 2500;
+            }
+
+            records.push_back({key, i});
+            keys.push_back(key);
+        }
+
+        auto isam = isam_t::build(records);
+        std::sort(keys.begin(), keys.end());
+
+        for (size_t i=0; i<100; i++) {
+            K lower = (K) (rand() % 5200);
+            if constexpr (std::is_signed_v<K>) {
+                lower -= 2600;
+            }
+
+            typename isam_t::RangeQueryParameters q;
+            q.lower_bound = lower;
+            q.upper_bound = lower + 50;
+
+            auto results = isam->query(&q);
+            auto test_itr = std::lower_bound(keys.begin(), keys.end(), q.lower_bound);
+            auto test_upper = std::lower_bound(keys.begin(), keys.end(), q.upper_bound);
+
+            ck_assert_int_eq(test_upper - test_itr, results.size());
+            for (size_t j=0; j<results.size(); j++) {
+                ck_assert(results[j].first == *test_itr);
+                test_itr++;
+            }
+        }
+
+        delete isam;
+    }
+}
+
+
+START_TEST(t_query_key_types)
+{
+    check_key_type<int32_t, 8>();
+    check_key_type<uint32_t, 8>();
+    check_key_type<float, 8>();
+    check_key_type<double, 4>();
+    check_key_type<uint64_t, 4>();
+    check_key_type<uint32_t, 16>();
+    check_key_type<int64_t, 4>();
+    check_key_type<uint64_t, 64>();
+    check_key_type<float, 32>();
+    check_key_type<double, 8>();
+    check_key_type<int16_t, 16>();
+    check_key_type<int64_t, 256>();
+}
+END_TEST
+
+
+START_TEST(t_query_layouts)
+{
+    check_key_type<int64_t, 64, psudb::ISAMLayout::IMPLICIT>();
+    check_key_type<int64_t, 8, psudb::ISAMLayout::IMPLICIT>();
+    check_key_type<uint32_t, 4, psudb::ISAMLayout::IMPLICIT>();
+    check_key_type<double, 256, psudb::ISAMLayout::IMPLICIT>();
+    check_key_type<int64_t, 64, psudb::ISAMLayout::EYTZINGER>();
+    check_key_type<int64_t, 8, psudb::ISAMLayout::EYTZINGER>();
+    check_key_type<float, 16, psudb::ISAMLayout::EYTZINGER>();
+    check_key_type<int16_t, 4, psudb::ISAMLayout::EYTZINGER>();
+}
+END_TEST
+
+
+template <size_t FANOUT, psudb::ISAMLayout LAYOUT>
+static void check_batch()
+{
+    typedef psudb::ISAMTree<key_type, val_type, FANOUT, LAYOUT> isam_t;
+
+    for (size_t n : {(size_t) 0, (size_t) 1, (size_t) 100, (size_t) 50000}) {
+        std::vector<record_t> records;
+        for (size_t i=0; i<n; i++) {
+            records.push_back({(key_type) (rand() % 100000), i});
+        }
+
+        auto isam = isam_t::build(records);
+
+        std::vector<key_type> keys;
+        for (size_t i=0; i<1001; i++) {
+            keys.push_back(rand() % 101000);
+        }
+
+        std::vector<size_t> results(keys.size());
+        isam->lower_bound_batch(keys, results);
+
+        for (size_t i=0; i<keys.size(); i++) {
+            ck_assert_int_eq(results[i], isam->lower_bound(keys[i]));
+
+            auto rec = isam->get_record_at(results[i]);
+            if (rec) {
+                ck_assert_int_ge(rec->first, keys[i]);
+            } else {
+                ck_assert_int_eq(results[i], n);
+            }
+        }
+
+        delete isam;
+    }
+}
+
+
+START_TEST(t_lower_bound_batch)
+{
+    check_batch<64, psudb::ISAMLayout::EXPLICIT>();
+    check_batch<4, psudb::ISAMLayout::EXPLICIT>();
+    check_batch<64, psudb::ISAMLayout::IMPLICIT>();
+    check_batch<8, psudb::ISAMLayout::IMPLICIT>();
+    check_batch<64, psudb::ISAMLayout::EYTZINGER>();
+    check_batch<16, psudb::ISAMLayout::EYTZINGER>();
+}
+END_TEST
+
+
+template <size_t FANOUT, psudb::ISAMLayout LAYOUT>
+static void check_parallel_build()
+{
+    typedef psudb::ISAMTree<key_type, val_type, FANOUT, LAYOUT> isam_t;
+
+    size_t n = 500000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) (rand() % 1000000), i});
+    }
+
+    /* split the records into unevenly sized, sorted runs */
+    std::vector<std::vector<record_t>> runs(7);
+    for (size_t i=0; i<n; i++) {
+        runs[(i * i) % runs.size()].push_back(records[i]);
+    }
+    for (auto &run : runs) {
+        std::sort(run.begin(), run.end());
+    }
+
+    std::vector<record_t> copy = records;
+    auto runs_copy = runs;
+    auto serial = isam_t::build(records);
+    auto parallel = isam_t::build(copy, 8);
+    auto merged = isam_t::build_from_runs(runs, 8);
+    auto kway = isam_t::build_from_runs(runs_copy);
+
+    ck_assert_int_eq(parallel->record_count(), n);
+    ck_assert_int_eq(merged->record_count(), n);
+    ck_assert_int_eq(kway->record_count(), n);
+    ck_assert_int_eq(parallel->internal_node_count(), serial->internal_node_count());
+    ck_assert_int_eq(parallel->index_memory_usage(), serial->index_memory_usage());
+
+    for (size_t i=0; i<n; i++) {
+        ck_assert(*parallel->get_record_at(i) == *serial->get_record_at(i));
+        ck_assert(*merged->get_record_at(i) == *serial->get_record_at(i));
+        ck_assert(*kway->get_record_at(i) == *serial->get_record_at(i));
+    }
+
+    for (size_t i=0; i<1000; i++) {
+        key_type key = rand() % 1010000;
+        ck_assert_int_eq(parallel->lower_bound(key), serial->lower_bound(key));
+        ck_assert_int_eq(merged->lower_bound(key), serial->lower_bound(key));
+    }
+
+    delete serial;
+    delete parallel;
+    delete merged;
+    delete kway;
+}
+
+
+START_TEST(t_build_parallel)
+{
+    check_parallel_build<64, psudb::ISAMLayout::EXPLICIT>();
+    check_parallel_build<4, psudb::ISAMLayout::EXPLICIT>();
+    check_parallel_build<8, psudb::ISAMLayout::IMPLICIT>();
+    check_parallel_build<16, psudb::ISAMLayout::EYTZINGER>();
+}
+END_TEST
+
+
+template <size_t FANOUT, psudb::ISAMLayout LAYOUT>
+static void check_arena_build(psudb::ArenaPool *pool)
+{
+    typedef psudb::ISAMTree<key_type, val_type, FANOUT, LAYOUT> isam_t;
+
+    for (size_t n : {(size_t) 1, (size_t) 1000, (size_t) 100000}) {
+        std::vector<record_t> records;
+        for (size_t i=0; i<n; i++) {
+            records.push_back({(key_type) (rand() % 200000), i});
+        }
+
+        std::vector<record_t> copy = records;
+        auto heap = isam_t::build(records);
+        auto arena = isam_t::build(copy, 1, pool);
+
+        ck_assert_int_eq(arena->record_count(), n);
+        ck_assert_int_eq(arena->internal_node_count(), heap->internal_node_count());
+        ck_assert_int_eq(arena->index_memory_usage(), heap->index_memory_usage());
+
+        for (size_t i=0; i<1000; i++) {
+            key_type key = rand() % 201000;
+            ck_assert_int_eq(arena->lower_bound(key), heap->lower_bound(key));
+        }
+
+        auto unbuilt = arena->unbuild();
+        ck_assert_int_eq(unbuilt.size(), n);
+        ck_assert(std::equal(unbuilt.begin(), unbuilt.end(), heap->get_record_at(0)));
+        ck_assert_int_eq(arena->record_count(), 0);
+
+        delete heap;
+        delete arena;
+    }
+}
+
+
+START_TEST(t_build_arena)
+{
+    for (auto huge : {psudb::HugePages::NONE, psudb::HugePages::TRANSPARENT, psudb::HugePages::EXPLICIT}) {
+        psudb::ArenaPool pool(huge);
+
+        check_arena_build<64, psudb::ISAMLayout::EXPLICIT>(&pool);
+        check_arena_build<4, psudb::ISAMLayout::EXPLICIT>(&pool);
+        check_arena_build<8, psudb::ISAMLayout::IMPLICIT>(&pool);
+        check_arena_build<16, psudb::ISAMLayout::EYTZINGER>(&pool);
+
+        /* the arenas of destroyed trees are reused by later builds */
+        ck_assert_int_gt(pool.get_reuse_count(), 0);
+        ck_assert_int_gt(pool.get_cached_bytes(), 0);
+
+        size_t mapped = pool.get_map_count();
+        std::vector<record_t> records;
+        for (size_t i=0; i<1000; i++) {
+            records.push_back({(key_type) i, i});
+        }
+
+        delete psudb::ISAMTree<key_type, val_type, 64>::build_presorted(records, 1, &pool);
+        ck_assert_int_eq(pool.get_map_count(), mapped);
+
+        pool.trim();
+        ck_assert_int_eq(pool.get_cached_bytes(), 0);
+    }
+}
+END_TEST
+
+
+START_TEST(t_layout_memory)
+{
+    size_t n = 10000;
+    std::vector<record_t> records;
+    for (size_t i=0; i<n; i++) {
+        records.push_back({(key_type) rand(), i});
+    }
+
+    auto copy = records;
+    auto isam = psudb::ISAMTree<key_type, val_type, 64>::build(copy);
+    copy = records;
+    auto implicit = psudb::ISAMTree<key_type, val_type, 64, psudb::ISAMLayout::IMPLICIT>::build(copy);
+    copy = records;
+    auto eytzinger = psudb::ISAMTree<key_type, val_type, 64, psudb::ISAMLayout::EYTZINGER>::build(copy);
+
+    /* the same nodes, without the child pointers */
+    ck_assert_int_eq(implicit->internal_node_count(), isam->internal_node_count());
+    ck_assert_int_eq(implicit->index_memory_usage() * 2, isam->index_memory_usage());
+
+    /* three nodes in the lowest level, plus a 3 entry Eytzinger array */
+    ck_assert_int_eq(eytzinger->internal_node_count(), 3);
+    ck_assert_int_eq(eytzinger->index_memory_usage(), (3 * 64 + 4) * sizeof(key_type));
+
+    delete isam;
+    delete implicit;
+    delete eytzinger;
+}
+END_TEST
+
+
 Suite *unit_testing()
 {
     Suite *unit = suite_create("Static ISAM Tree Unit Testing");
@@ -308,11 +653,19 @@ Suite *unit_testing()
     tcase_add_test(build, t_build_oneleaf);
     tcase_add_test(build, t_build_onerec);
     tcase_add_test(build, t_build_tworec);
+    tcase_add_test(build, t_build_parallel);
+    tcase_add_test(build, t_build_arena);
 
+    tcase_set_timeout(build, 1000);
     suite_add_tcase(unit, build);
 
     TCase *query = tcase_create("Static ISAM Query Testing");
     tcase_add_test(query, t_query);
+    tcase_add_test(query, t_range);
+    tcase_add_test(query, t_query_key_types);
+    tcase_add_test(query, t_query_layouts);
+    tcase_add_test(query, t_layout_memory);
+    tcase_add_test(query, t_lower_bound_batch);
 
     tcase_set_timeout(query, 1000);
     suite_add_tcase(unit, query);
@@ -0,0 +1,213 @@
+/*
+ *  tests/stripedfile_tests.cpp
+ *
+ *  Copyright (C) 2023 Douglas B. Rumbaugh <drumbaugh@psu.edu>
+ *  Distributed under the Modified BSD License.
+ */
+#include <string>
+#include <vector>
+
+#include "psu-io/StripedFile.h"
+
+#include <check.h>
+
+using namespace psudb;
+
+std::vector<std::string> test_files = {"bin/tests/data/striped_file0.dat",
+                                       "bin/tests/data/striped_file1.dat",
+                                       "bin/tests/data/striped_file2.dat"};
+
+
+static byte *fill_pages(size_t pg_cnt, PageNum first) {
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, pg_cnt * PAGE_SIZE);
+    for (size_t i=0; i<pg_cnt; i++) {
+        *((PageNum *) get_page(buffer, i)) = first + i;
+    }
+
+    return buffer;
+}
+
+
+static void check_roundtrip(PageNum stripe_pages, bool async)
+{
+    auto sfile = StripedFile::create(test_files, true, true, stripe_pages);
+    ck_assert_ptr_nonnull(sfile.get());
+
+    /* async IO is enabled by create, where it is supported */
+    ck_assert(sfile->supports_async_io());
+    if (!async) {
+        sfile->disable_async_io();
+        ck_assert(!sfile->supports_async_io());
+    }
+
+    size_t pg_cnt = 101;
+    ck_assert_int_eq(sfile->allocate_pages(pg_cnt), 1);
+    ck_assert_int_eq(sfile->get_page_count(), pg_cnt);
+
+    /* every file holds its share of the pages */
+    size_t local_cnt = 0;
+    for (size_t i=0; i<sfile->get_file_count(); i++) {
+        ck_assert_int_gt(sfile->get_file(i)->get_page_count(), 0);
+        local_cnt += sfile->get_file(i)->get_page_count();
+    }
+    ck_assert_int_eq(local_cnt, pg_cnt);
+
+    byte *data = fill_pages(pg_cnt, 1);
+    ck_assert_int_eq(sfile->write_pages(1, pg_cnt, data), 1);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, pg_cnt * PAGE_SIZE);
+    ck_assert_int_eq(sfile->read_pages(1, pg_cnt, buffer), 1);
+    ck_assert_int_eq(memcmp(buffer, data, pg_cnt * PAGE_SIZE), 0);
+
+    ck_assert_int_eq(sfile->read_page(57, buffer), 1);
+    ck_assert_int_eq(*((PageNum *) buffer), 57);
+
+    memset(buffer, 0, pg_cnt * PAGE_SIZE);
+    std::vector<std::pair<PageNum, byte*>> pages = {{90, get_page(buffer, 0)}, {3, get_page(buffer, 1)}, {4, get_page(buffer, 2)}};
+    ck_assert_int_eq(sfile->read_pages(pages), 1);
+    ck_assert_int_eq(*((PageNum *) get_page(buffer, 0)), 90);
+    ck_assert_int_eq(*((PageNum *) get_page(buffer, 1)), 3);
+    ck_assert_int_eq(*((PageNum *) get_page(buffer, 2)), 4);
+
+    /* out of range accesses are rejected */
+    ck_assert_int_eq(sfile->read_page(0, buffer), 0);
+    ck_assert_int_eq(sfile->read_page(pg_cnt + 1, buffer), 0);
+    ck_assert_int_eq(sfile->read_pages(pg_cnt, 2, buffer), 0);
+    ck_assert_int_eq(sfile->write_pages(pg_cnt, 2, data), 0);
+
+    free(data);
+    free(buffer);
+}
+
+
+START_TEST(t_roundtrip_interleaved)
+{
+    check_roundtrip(1, false);
+}
+END_TEST
+
+
+START_TEST(t_roundtrip_extents)
+{
+    check_roundtrip(8, false);
+}
+END_TEST
+
+
+START_TEST(t_roundtrip_async)
+{
+    check_roundtrip(1, true);
+    check_roundtrip(8, true);
+}
+END_TEST
+
+
+START_TEST(t_reopen)
+{
+    size_t pg_cnt = 50;
+    {
+        auto sfile = StripedFile::create(test_files, true, true, 4);
+        ck_assert_int_eq(sfile->allocate_pages(pg_cnt), 1);
+
+        byte *data = fill_pages(pg_cnt, 1);
+        ck_assert_int_eq(sfile->write_pages(1, pg_cnt, data), 1);
+        free(data);
+    }
+
+    /* a different layout is inconsistent with the files' sizes */
+    ck_assert_ptr_null(StripedFile::create(test_files, false, true, 1).get());
+
+    auto sfile = StripedFile::create(test_files, false, true, 4);
+    ck_assert_ptr_nonnull(sfile.get());
+    ck_assert_int_eq(sfile->get_page_count(), pg_cnt);
+
+    ck_assert_int_eq(sfile->allocate_pages(3), pg_cnt + 1);
+
+    byte *buffer = (byte *) aligned_alloc(SECTOR_SIZE, PAGE_SIZE);
+    for (PageNum p=1; p<=pg_cnt; p++) {
+        ck_assert_int_eq(sfile->read_page(p, buffer), 1);
+        ck_assert_int_eq(*((PageNum *) buffer), p);
+    }
+    free(buffer);
+
+    ck_assert_int_eq(sfile->remove_files(), 1);
+}
+END_TEST
+
+
+START_TEST(t_scan)
+{
+    auto sfile = StripedFile::create(test_files, true, true, 2);
+    ck_assert_int_eq(sfile->enable_async_io(), 1);
+
+    size_t pg_cnt = 200;
+    sfile->allocate_pages(pg_cnt);
+    byte *data = fill_pages(pg_cnt, 1);
+    ck_assert_int_eq(sfile->write_pages(1, pg_cnt, data), 1);
+    free(data);
+
+    ck_assert_ptr_null(sfile->start_scan(0).get());
+    ck_assert_ptr_null(sfile->start_scan(1, pg_cnt + 1).get());
+
+    auto itr = sfile->start_scan(1, 0, sfile->get_stripe_width() * 4);
+    PageNum expected = 1;
+    while (itr->next()) {
+        ck_assert_int_eq(*((PageNum *) itr->get_item()), expected);
+        expected++;
+    }
+    ck_assert_int_eq(expected, pg_cnt + 1);
+
+    itr = sfile->start_scan(17, 33, 5);
+    expected = 17;
+    while (itr->next()) {
+        ck_assert_int_eq(*((PageNum *) itr->get_item()), expected);
+        expected++;
+    }
+    ck_assert_int_eq(expected, 34);
+
+    /* the backing files' statistics are combined */
+    auto stats = sfile->get_stats();
+    ck_assert_int_gt(stats.reads().ops, 0);
+}
+END_TEST
+
+
+Suite *unit_testing()
+{
+    Suite *unit = suite_create("StripedFile Unit Testing");
+
+    TCase *io = tcase_create("StripedFile IO Testing");
+    tcase_add_test(io, t_roundtrip_interleaved);
+    tcase_add_test(io, t_roundtrip_extents);
+    tcase_add_test(io, t_roundtrip_async);
+    tcase_add_test(io, t_reopen);
+    suite_add_tcase(unit, io);
+
+    TCase *scan = tcase_create("StripedFile::start_scan Testing");
+    tcase_add_test(scan, t_scan);
+    suite_add_tcase(unit, scan);
+
+    return unit;
+}
+
+
+int run_unit_tests()
+{
+    int failed = 0;
+    Suite *unit = unit_testing();
+    SRunner *unit_runner = srunner_create(unit);
+
+    srunner_run_all(unit_runner, CK_NORMAL);
+    failed = srunner_ntests_failed(unit_runner);
+    srunner_free(unit_runner);
+
+    return failed;
+}
+
+
+int main()
+{
+    int unit_failed = run_unit_tests();
+
+    return (unit_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}